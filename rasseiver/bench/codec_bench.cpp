@@ -0,0 +1,240 @@
+/*
+ * Checks that the codec is lossless, and measures it.
+ *
+ * Blocks of interleaved 16 bits IQ samples are encoded, decoded, and compared
+ * bit for bit to the originals.  They are synthetic (noise at several levels,
+ * tones, full scale extremes, and blocks of odd sizes), or read from files of
+ * raw samples given as arguments, such as the recordings of a server.  The
+ * compression ratio and the encoding and decoding rates are then printed.
+ *
+ * Usage: codec-bench [-n values per block] [file...]
+ *
+ * The exit status is 1 if any block does not decode to its original.
+ */
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+#include <unistd.h>
+
+#include "codec.hpp"
+
+using Block = std::vector<int16_t>;
+
+/**
+ * Adds the synthetic blocks to a list.
+ *
+ * @param blocks The list.
+ * @param count The amount of values in most blocks.
+ */
+static void synthetic_blocks(std::vector<Block> &blocks, size_t count) {
+	std::minstd_rand random {1};
+
+	// Uniform noise, from silence to the full scale.
+	for (int level: {0, 1, 7, 100, 2047, 32767}) {
+		std::uniform_int_distribution<int> noise {-level - 1, level};
+
+		for (int i = 0; i < 4; i++) {
+			Block block (count);
+
+			for (auto &value: block) {
+				value = static_cast<int16_t> (noise(random));
+			}
+
+			blocks.push_back(std::move(block));
+		}
+	}
+
+	// Tones with a little noise, as the filtered signal of an ILS.
+	std::normal_distribution<double> noise {0, 3};
+
+	for (double amplitude: {500.0, 2000.0, 32000.0}) {
+		Block block (count);
+
+		for (size_t i = 0; i < count; i += 2) {
+			const double phase {0.0123 * i};
+
+			block[i] = static_cast<int16_t> (std::lround(
+				amplitude * std::cos(phase) + noise(random)));
+			block[i + 1] = static_cast<int16_t> (std::lround(
+				amplitude * std::sin(phase) + noise(random)));
+		}
+
+		blocks.push_back(std::move(block));
+	}
+
+	// The worst case for the predictors, whose residuals do not fit in 16
+	// bits.
+	Block extremes (count);
+
+	for (size_t i = 0; i < count; i++) {
+		extremes[i] = i % 4 < 2 ? INT16_MIN : INT16_MAX;
+	}
+
+	blocks.push_back(std::move(extremes));
+
+	// Sizes shorter than the orders of the predictors, and which are not
+	// multiples of the partitions.
+	std::uniform_int_distribution<int> any {INT16_MIN, INT16_MAX};
+
+	for (size_t size: {0, 2, 4, 6, 8, 10, 510, 514, 1026}) {
+		Block block (std::min(size, count));
+
+		for (auto &value: block) {
+			value = static_cast<int16_t> (any(random) / 64);
+		}
+
+		blocks.push_back(std::move(block));
+	}
+}
+
+/**
+ * Adds the blocks of a file of raw interleaved IQ samples to a list.
+ *
+ * @param blocks The list.
+ * @param path The file.
+ * @param count The amount of values in a block.  The last block may be
+ *   shorter.
+ * @returns false if the file cannot be read.
+ */
+static bool file_blocks(std::vector<Block> &blocks, std::string const &path,
+			size_t count) {
+	std::ifstream file {path, std::ios::binary};
+
+	if (!file) {
+		return false;
+	}
+
+	for (;;) {
+		Block block (count);
+
+		file.read(reinterpret_cast<char *> (block.data()),
+			  count * sizeof(int16_t));
+		block.resize(file.gcount() / sizeof(int16_t) / 2 * 2);
+
+		if (block.empty()) {
+			return true;
+		}
+
+		blocks.push_back(std::move(block));
+	}
+}
+
+int main(int argc, char *argv[]) {
+	// An output block for a buffer of 65536 IQ samples decimated by 60.
+	size_t count {2184};
+	int opt;
+
+	while ((opt = getopt(argc, argv, "n:")) != -1) {
+		if (opt == 'n') {
+			count = std::strtoul(optarg, nullptr, 10) / 2 * 2;
+		} else {
+			std::cerr << "Usage: " << argv[0]
+				  << " [-n values per block] [file...]"
+				  << std::endl;
+			return EXIT_FAILURE;
+		}
+	}
+
+	if (count == 0) {
+		std::cerr << "The blocks must hold at least one IQ sample"
+			  << std::endl;
+		return EXIT_FAILURE;
+	}
+
+	std::vector<Block> blocks;
+
+	if (optind == argc) {
+		synthetic_blocks(blocks, count);
+	}
+
+	for (int i = optind; i < argc; i++) {
+		if (!file_blocks(blocks, argv[i], count)) {
+			std::cerr << "Cannot read " << argv[i] << std::endl;
+			return EXIT_FAILURE;
+		}
+	}
+
+	Encoder encoder {count};
+	std::vector<std::vector<uint8_t>> encoded (blocks.size());
+	Block decoded (count);
+	size_t bytes_in {0}, bytes_out {0}, failures {0};
+
+	for (size_t i = 0; i < blocks.size(); i++) {
+		Block const &block {blocks[i]};
+
+		encoded[i].resize(Encoder::max_size(block.size()));
+		encoded[i].resize(encoder.encode(block.data(), block.size(),
+						 encoded[i].data()));
+
+		const ssize_t values {codec_decode(encoded[i].data(),
+						   encoded[i].size(),
+						   decoded.data(),
+						   decoded.size())};
+
+		if (values != static_cast<ssize_t> (block.size()) ||
+		    !std::equal(block.begin(), block.end(), decoded.begin())) {
+			std::cerr << "Block " << i << " (" << block.size()
+				  << " values) does not decode to its original"
+				  << std::endl;
+			failures++;
+		}
+
+		bytes_in += block.size() * sizeof(int16_t);
+		bytes_out += encoded[i].size();
+	}
+
+	// Each pass is timed as a whole, the fastest one is kept.
+	constexpr int rounds {20};
+	std::vector<uint8_t> output (Encoder::max_size(count));
+	double encode_time {INFINITY}, decode_time {INFINITY};
+
+	for (int round = 0; round < rounds; round++) {
+		auto start = std::chrono::steady_clock::now();
+
+		for (auto const &block: blocks) {
+			encoder.encode(block.data(), block.size(),
+				       output.data());
+		}
+
+		auto middle = std::chrono::steady_clock::now();
+
+		for (auto const &block: encoded) {
+			codec_decode(block.data(), block.size(),
+				     decoded.data(), decoded.size());
+		}
+
+		auto end = std::chrono::steady_clock::now();
+
+		encode_time = std::min(encode_time,
+				       std::chrono::duration<double> (
+					       middle - start).count());
+		decode_time = std::min(decode_time,
+				       std::chrono::duration<double> (
+					       end - middle).count());
+	}
+
+	std::cout << blocks.size() << " blocks, " << bytes_in << " -> "
+		  << bytes_out << " bytes (ratio "
+		  << (double) bytes_in / bytes_out << ")" << std::endl
+		  << "Encoding: " << bytes_in / encode_time / 1e6
+		  << " MB/s on one core" << std::endl
+		  << "Decoding: " << bytes_in / decode_time / 1e6
+		  << " MB/s on one core" << std::endl;
+
+	if (failures > 0) {
+		std::cerr << failures << " blocks are not decoded bit-exact"
+			  << std::endl;
+		return EXIT_FAILURE;
+	}
+
+	std::cout << "Every block is decoded bit-exact" << std::endl;
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,230 @@
+/*
+ * Measures the accuracy and the speed of the filtering engines.
+ *
+ * A noisy tone, quantised like the samples of an ADC, is filtered by each
+ * engine of make_engines() ("auto" precision).  The outputs are compared to
+ * those of a double precision DirectEngine fed with the same samples before
+ * quantisation, so the SNR of each engine includes the quantisation noise of
+ * the ADC, and the loss of an engine is its SNR against the one of the double
+ * precision engine.  The time taken to filter a buffer is printed as well.
+ *
+ * Usage: filter-bench [-d decimation] [-m max value] [-n buffer size]
+ *                     [-t threads] filter
+ *
+ * The max value is the one of the device (2048 for 12 bits samples), and the
+ * size of the buffers is in IQ samples.  With several threads, the engines
+ * run in a ParallelEngine, as with the filter_threads parameter.
+ */
+
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+
+#include <unistd.h>
+
+#include "engine.hpp"
+#include "worker_pool.hpp"
+
+/**
+ * Filters buffers with an engine, and returns the time taken by a buffer, in
+ * milliseconds, for the fastest of several rounds.
+ *
+ * @param engine The engine.
+ * @param inputs The buffers, filtered in order, as a stream.
+ * @param output Where the outputs of the last round are written.
+ */
+template<typename T>
+static double run(FilterEngine<T> const &engine,
+		  std::vector<std::vector<T>> &inputs,
+		  std::vector<float> &output) {
+	constexpr int rounds {5};
+	const size_t size {inputs.front().size()};
+	auto best = std::chrono::steady_clock::duration::max();
+
+	for (int round = 0; round < rounds; round++) {
+		CircularBuffer<T> buffer {size};
+		size_t pos {0};
+		auto elapsed = std::chrono::steady_clock::duration::zero();
+
+		output.resize((size / engine.step() + 1) * inputs.size());
+
+		SampleWriter writer {SampleFormat::float32, 1,
+				     reinterpret_cast<uint8_t *> (
+					     output.data())};
+
+		for (auto &input: inputs) {
+			buffer.switch_buffer(input.data(), input.size());
+
+			auto start = std::chrono::steady_clock::now();
+			engine.apply(buffer, writer, pos);
+			writer.flush();
+			elapsed += std::chrono::steady_clock::now() - start;
+
+			pos %= buffer.size();
+		}
+
+		output.resize(writer.size() / sizeof(float));
+		best = std::min(best, elapsed);
+	}
+
+	return std::chrono::duration<double, std::milli> (best).count() /
+		inputs.size();
+}
+
+/**
+ * Returns the ratio of the power of a signal to the power of its difference
+ * with another, in dB.  The first outputs are skipped, as the filter has no
+ * history for them.
+ *
+ * @param reference The signal.
+ * @param output The other signal.
+ * @param skip The amount of values skipped.
+ */
+static double snr(std::vector<float> const &reference,
+		  std::vector<float> const &output, size_t skip) {
+	double signal {0}, noise {0};
+
+	for (size_t i = skip; i < reference.size() && i < output.size(); i++) {
+		const double error {(double) output[i] - reference[i]};
+
+		signal += (double) reference[i] * reference[i];
+		noise += error * error;
+	}
+
+	return noise > 0 ? 10 * std::log10(signal / noise) : INFINITY;
+}
+
+int main(int argc, char *argv[]) {
+	int step {60};
+	int max_value {2048};
+	size_t bufsize {65536};
+	int threads {1};
+	int opt;
+
+	while ((opt = getopt(argc, argv, "d:m:n:t:")) != -1) {
+		switch (opt) {
+		case 'd':
+			step = std::atoi(optarg);
+			break;
+		case 'm':
+			max_value = std::atoi(optarg);
+			break;
+		case 'n':
+			bufsize = std::strtoul(optarg, nullptr, 10);
+			break;
+		case 't':
+			threads = std::atoi(optarg);
+			break;
+		default:
+			optind = argc;
+			break;
+		}
+	}
+
+	if (optind != argc - 1 || step < 1 || max_value < 1 ||
+	    bufsize == 0 || threads < 1) {
+		std::cerr << "Usage: " << argv[0] << " [-d decimation] "
+			  << "[-m max value] [-n buffer size] [-t threads] "
+			  << "filter" << std::endl;
+		return EXIT_FAILURE;
+	}
+
+	Filter filter;
+
+	try {
+		filter_read_file(argv[optind], filter);
+	} catch (std::runtime_error &e) {
+		std::cerr << e.what() << std::endl;
+		return EXIT_FAILURE;
+	}
+
+	// A tone in the passband at 70% of the full scale, with a little noise
+	// so that the quantisation noise is white.
+	constexpr int buffers {16};
+	std::minstd_rand random {1};
+	std::normal_distribution<double> noise {0, 0.5};
+	std::vector<std::vector<double>> exact (buffers);
+	std::vector<std::vector<int16_t>> quantised (buffers);
+	const double frequency {0.1 / step};
+	const double amplitude {0.7 * max_value};
+	size_t n {0};
+
+	for (int b = 0; b < buffers; b++) {
+		exact[b].resize(bufsize * 2);
+		quantised[b].resize(bufsize * 2);
+
+		for (size_t i = 0; i < bufsize * 2; i += 2, n++) {
+			const double phase {2 * M_PI * frequency * n};
+
+			exact[b][i] = amplitude * std::cos(phase) +
+				noise(random);
+			exact[b][i + 1] = amplitude * std::sin(phase) +
+				noise(random);
+
+			for (size_t k: {i, i + 1}) {
+				quantised[b][k] = static_cast<int16_t> (
+					std::max(-max_value, std::min(
+							 max_value - 1,
+							 static_cast<int> (
+								 std::lround(
+									 exact[b][k])))));
+			}
+		}
+	}
+
+	std::vector<float> reference, output;
+	const size_t skip {(filter.size() / step + 1) * 2};
+
+	run<double> (DirectEngine<double, double> {filter, step}, exact,
+		     reference);
+
+	std::cout << filter.size() << " taps, decimation " << step
+		  << ", buffers of " << bufsize << " IQ samples, max value "
+		  << max_value << ", " << threads << " thread(s)" << std::endl
+		  << std::setw(16) << std::left << "engine"
+		  << std::setw(12) << std::right << "ms/buffer"
+		  << std::setw(12) << "MS/s"
+		  << std::setw(12) << "SNR (dB)"
+		  << std::setw(12) << "loss (dB)" << std::endl
+		  << std::fixed;
+
+	// The benchmark is the only caller of the pool.
+	WorkerPool workers {(size_t) threads - 1, 1, ThreadPolicy {{}, 0}};
+	double baseline {NAN};
+
+	for (auto &engine: make_engines<int16_t> ("auto", filter, step,
+						  max_value)) {
+		if (threads > 1) {
+			engine = std::make_unique<ParallelEngine<int16_t>> (
+				std::move(engine), workers);
+		}
+
+		const double time {run(*engine, quantised, output)};
+		const double ratio {snr(reference, output, skip)};
+
+		// The first engine is the double precision one.
+		if (std::isnan(baseline)) {
+			baseline = ratio;
+		}
+
+		std::cout << std::setw(16) << std::left << engine->name()
+			  << std::setw(12) << std::right
+			  << std::setprecision(3) << time
+			  << std::setw(12) << std::setprecision(1)
+			  << bufsize / time / 1e3
+			  << std::setw(12) << std::setprecision(2) << ratio
+			  << std::setw(12) << std::setprecision(4)
+			  << baseline - ratio << std::endl;
+
+		// Frees the slot of the pool for the next one.
+		engine.reset();
+	}
+
+	return EXIT_SUCCESS;
+}
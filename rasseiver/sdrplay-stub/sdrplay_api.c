@@ -0,0 +1,407 @@
+/*
+ * A stub of the SDRplay API, enumerating a single RSPduo whose tuners replay
+ * files of interleaved 16 bits I/Q samples, in a loop, at the sample rate of
+ * the device: 2 MSPS per tuner in dual tuner mode, fsHz otherwise.  The files
+ * are named by the SDRPLAY_STUB_FILE_A and SDRPLAY_STUB_FILE_B environment
+ * variables; a tuner without a file streams zeros.
+ *
+ * Like the API, each callback delivers a varying amount of samples, as
+ * separate I and Q arrays, and the first one of a stream has reset set.
+ *
+ * If SDRPLAY_STUB_REMOVE_AFTER is set, the RSPduo is removed once, after that
+ * amount of callbacks: the event callback is told so, and the samples stop
+ * until it is selected again.  If SDRPLAY_STUB_ABSENT_MS is set too, it is
+ * not enumerated for that many milliseconds after its removal, as if it was
+ * unplugged.
+ */
+
+#define _GNU_SOURCE
+
+#include <errno.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "sdrplay_api.h"
+
+#define STUB_MAX_SAMPLES 2016
+#define STUB_PACKET_SAMPLES 252
+
+struct stub_tuner {
+	short *samples;  /* Interleaved I/Q */
+	size_t count;    /* In I/Q samples */
+	size_t pos;
+	unsigned int first_sample;
+	int reset;
+	short xi[STUB_MAX_SAMPLES];
+	short xq[STUB_MAX_SAMPLES];
+};
+
+static pthread_mutex_t api_lock = PTHREAD_MUTEX_INITIALIZER;
+static int selected;
+static struct timespec removed_at;
+static int removed;
+static sdrplay_api_DeviceT device;
+
+static sdrplay_api_DevParamsT dev_params;
+static sdrplay_api_RxChannelParamsT channel_a;
+static sdrplay_api_RxChannelParamsT channel_b;
+static sdrplay_api_DeviceParamsT params = {
+	&dev_params, &channel_a, &channel_b,
+};
+
+static pthread_t thread;
+static volatile int running;
+static sdrplay_api_CallbackFnsT callbacks;
+static void *context;
+static struct stub_tuner tuners[2];
+
+static HANDLE stub_handle(void) {
+	return &device;
+}
+
+sdrplay_api_ErrT sdrplay_api_Open(void) {
+	return sdrplay_api_Success;
+}
+
+sdrplay_api_ErrT sdrplay_api_Close(void) {
+	return sdrplay_api_Success;
+}
+
+sdrplay_api_ErrT sdrplay_api_ApiVersion(float *apiVer) {
+	*apiVer = SDRPLAY_API_VERSION;
+	return sdrplay_api_Success;
+}
+
+sdrplay_api_ErrT sdrplay_api_LockDeviceApi(void) {
+	pthread_mutex_lock(&api_lock);
+	return sdrplay_api_Success;
+}
+
+sdrplay_api_ErrT sdrplay_api_UnlockDeviceApi(void) {
+	pthread_mutex_unlock(&api_lock);
+	return sdrplay_api_Success;
+}
+
+sdrplay_api_ErrT sdrplay_api_GetDevices(sdrplay_api_DeviceT *devices,
+					unsigned int *numDevs,
+					unsigned int maxDevs) {
+	*numDevs = 0;
+
+	/* A selected device is not available anymore */
+	if (maxDevs == 0 || selected) {
+		return sdrplay_api_Success;
+	}
+
+	if (removed) {
+		char const *absent = getenv("SDRPLAY_STUB_ABSENT_MS");
+		struct timespec now;
+
+		clock_gettime(CLOCK_MONOTONIC, &now);
+
+		if (absent != NULL &&
+		    (now.tv_sec - removed_at.tv_sec) * 1000 +
+		    (now.tv_nsec - removed_at.tv_nsec) / 1000000 <
+		    atol(absent)) {
+			return sdrplay_api_Success;
+		}
+	}
+
+	memset(devices, 0, sizeof(*devices));
+	strcpy(devices->SerNo, "STUB0001");
+	devices->hwVer = SDRPLAY_RSPduo_ID;
+	devices->tuner = sdrplay_api_Tuner_Both;
+	devices->rspDuoMode = sdrplay_api_RspDuoMode_Single_Tuner |
+		sdrplay_api_RspDuoMode_Dual_Tuner |
+		sdrplay_api_RspDuoMode_Master;
+	devices->dev = stub_handle();
+	*numDevs = 1;
+
+	return sdrplay_api_Success;
+}
+
+sdrplay_api_ErrT sdrplay_api_SelectDevice(sdrplay_api_DeviceT *dev) {
+	if (selected || dev->dev != stub_handle()) {
+		return sdrplay_api_Fail;
+	}
+
+	if (dev->rspDuoMode != sdrplay_api_RspDuoMode_Single_Tuner &&
+	    dev->rspDuoMode != sdrplay_api_RspDuoMode_Dual_Tuner &&
+	    dev->rspDuoMode != sdrplay_api_RspDuoMode_Master) {
+		return sdrplay_api_InvalidParam;
+	}
+
+	if (dev->rspDuoMode == sdrplay_api_RspDuoMode_Dual_Tuner) {
+		dev->tuner = sdrplay_api_Tuner_Both;
+	} else if (dev->tuner != sdrplay_api_Tuner_A &&
+		   dev->tuner != sdrplay_api_Tuner_B) {
+		return sdrplay_api_InvalidParam;
+	}
+
+	device = *dev;
+	selected = 1;
+
+	memset(&dev_params, 0, sizeof(dev_params));
+	memset(&channel_a, 0, sizeof(channel_a));
+	memset(&channel_b, 0, sizeof(channel_b));
+	dev_params.fsFreq.fsHz = 2000000;
+	channel_a.tunerParams.rfFreq.rfHz = 200000000;
+	channel_a.tunerParams.gain.gRdB = 50;
+	channel_a.ctrlParams.agc.enable = sdrplay_api_AGC_50HZ;
+	channel_b = channel_a;
+
+	return sdrplay_api_Success;
+}
+
+sdrplay_api_ErrT sdrplay_api_ReleaseDevice(sdrplay_api_DeviceT *dev) {
+	if (!selected || dev->dev != stub_handle()) {
+		return sdrplay_api_Fail;
+	}
+
+	selected = 0;
+	return sdrplay_api_Success;
+}
+
+const char *sdrplay_api_GetErrorString(sdrplay_api_ErrT err) {
+	switch (err) {
+	case sdrplay_api_Success:
+		return "sdrplay_api_Success";
+	case sdrplay_api_Fail:
+		return "sdrplay_api_Fail";
+	case sdrplay_api_InvalidParam:
+		return "sdrplay_api_InvalidParam";
+	case sdrplay_api_OutOfRange:
+		return "sdrplay_api_OutOfRange";
+	case sdrplay_api_AlreadyInitialised:
+		return "sdrplay_api_AlreadyInitialised";
+	case sdrplay_api_NotInitialised:
+		return "sdrplay_api_NotInitialised";
+	}
+
+	return "Unknown error";
+}
+
+sdrplay_api_ErrT sdrplay_api_DebugEnable(HANDLE dev,
+					 sdrplay_api_DbgLvl_t enable) {
+	(void) dev;
+	(void) enable;
+	return sdrplay_api_Success;
+}
+
+sdrplay_api_ErrT sdrplay_api_GetDeviceParams(
+	HANDLE dev, sdrplay_api_DeviceParamsT **deviceParams) {
+	if (!selected || dev != stub_handle()) {
+		return sdrplay_api_Fail;
+	}
+
+	*deviceParams = &params;
+	return sdrplay_api_Success;
+}
+
+/*
+ * Reads the samples of a tuner.
+ */
+static void stub_load(struct stub_tuner *tuner, char const *variable) {
+	char const *path = getenv(variable);
+	FILE *file;
+	long size;
+
+	memset(tuner, 0, sizeof(*tuner));
+	tuner->reset = 1;
+
+	if (path == NULL || (file = fopen(path, "rb")) == NULL) {
+		return;
+	}
+
+	fseek(file, 0, SEEK_END);
+	size = ftell(file);
+	fseek(file, 0, SEEK_SET);
+
+	tuner->count = size > 0 ? (size_t) size / (2 * sizeof(short)) : 0;
+	tuner->samples = malloc(tuner->count * 2 * sizeof(short));
+
+	if (tuner->samples == NULL ||
+	    fread(tuner->samples, 2 * sizeof(short), tuner->count, file) !=
+	    tuner->count) {
+		free(tuner->samples);
+		tuner->samples = NULL;
+		tuner->count = 0;
+	}
+
+	fclose(file);
+}
+
+/*
+ * Delivers the next samples of a tuner.
+ */
+static void stub_deliver(struct stub_tuner *tuner,
+			 sdrplay_api_StreamCallback_t callback,
+			 unsigned int count) {
+	sdrplay_api_StreamCbParamsT cb_params;
+	unsigned int i;
+
+	for (i = 0; i < count; i++) {
+		if (tuner->count > 0) {
+			tuner->xi[i] = tuner->samples[2 * tuner->pos];
+			tuner->xq[i] = tuner->samples[2 * tuner->pos + 1];
+			tuner->pos = (tuner->pos + 1) % tuner->count;
+		} else {
+			tuner->xi[i] = 0;
+			tuner->xq[i] = 0;
+		}
+	}
+
+	memset(&cb_params, 0, sizeof(cb_params));
+	cb_params.firstSampleNum = tuner->first_sample;
+	cb_params.numSamples = count;
+	callback(tuner->xi, tuner->xq, &cb_params, count, tuner->reset,
+		 context);
+
+	tuner->first_sample += count;
+	tuner->reset = 0;
+}
+
+static void *stub_run(void *arg) {
+	const int dual = device.rspDuoMode == sdrplay_api_RspDuoMode_Dual_Tuner;
+	const double rate = dual ? 2000000 : dev_params.fsFreq.fsHz;
+	char const *remove_after = getenv("SDRPLAY_STUB_REMOVE_AFTER");
+	static long callbacks_left = -1;
+	unsigned int seed = 1;
+	double elapsed = 0;
+	struct timespec start, deadline;
+
+	(void) arg;
+	clock_gettime(CLOCK_MONOTONIC, &start);
+
+	/* -1 before the removal, -2 while removed, -3 after */
+	if (callbacks_left == -1 && remove_after != NULL) {
+		callbacks_left = atol(remove_after);
+	} else if (callbacks_left == -2) {
+		callbacks_left = -3;
+	}
+
+	while (running) {
+		/* Between 1 and 8 packets, as the API does */
+		unsigned int count;
+
+		seed = seed * 1103515245 + 12345;
+		count = STUB_PACKET_SAMPLES * (1 + (seed >> 16) % 8);
+
+		if (callbacks_left == 0) {
+			callbacks_left = -2;
+			clock_gettime(CLOCK_MONOTONIC, &removed_at);
+			removed = 1;
+			callbacks.EventCbFn(sdrplay_api_DeviceRemoved,
+					    device.tuner, NULL, context);
+		}
+
+		if (callbacks_left == -2) {
+			struct timespec pause = {0, 10000000};
+
+			nanosleep(&pause, NULL);
+			continue;
+		}
+
+		if (callbacks_left > 0) {
+			callbacks_left--;
+		}
+
+		if (dual || device.tuner == sdrplay_api_Tuner_A) {
+			stub_deliver(&tuners[0], callbacks.StreamACbFn, count);
+		}
+
+		if (dual || device.tuner == sdrplay_api_Tuner_B) {
+			/* The stream of tuner B goes to StreamBCbFn in dual
+			 * tuner mode only */
+			stub_deliver(&tuners[1], dual ? callbacks.StreamBCbFn :
+				     callbacks.StreamACbFn, count);
+		}
+
+		elapsed += count / rate;
+		deadline.tv_sec = start.tv_sec + (time_t) elapsed;
+		deadline.tv_nsec = start.tv_nsec +
+			(long) ((elapsed - (time_t) elapsed) * 1e9);
+
+		if (deadline.tv_nsec >= 1000000000) {
+			deadline.tv_sec++;
+			deadline.tv_nsec -= 1000000000;
+		}
+
+		while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME,
+				       &deadline, NULL) == EINTR) {
+		}
+	}
+
+	return NULL;
+}
+
+sdrplay_api_ErrT sdrplay_api_Init(HANDLE dev,
+				  sdrplay_api_CallbackFnsT *callbackFns,
+				  void *cbContext) {
+	if (!selected || dev != stub_handle()) {
+		return sdrplay_api_Fail;
+	}
+
+	if (running) {
+		return sdrplay_api_AlreadyInitialised;
+	}
+
+	if (callbackFns == NULL || callbackFns->StreamACbFn == NULL ||
+	    (device.rspDuoMode == sdrplay_api_RspDuoMode_Dual_Tuner &&
+	     callbackFns->StreamBCbFn == NULL) ||
+	    callbackFns->EventCbFn == NULL) {
+		return sdrplay_api_InvalidParam;
+	}
+
+	callbacks = *callbackFns;
+	context = cbContext;
+	stub_load(&tuners[0], "SDRPLAY_STUB_FILE_A");
+	stub_load(&tuners[1], "SDRPLAY_STUB_FILE_B");
+
+	running = 1;
+
+	if (pthread_create(&thread, NULL, stub_run, NULL) != 0) {
+		running = 0;
+		return sdrplay_api_Fail;
+	}
+
+	return sdrplay_api_Success;
+}
+
+sdrplay_api_ErrT sdrplay_api_Uninit(HANDLE dev) {
+	if (dev != stub_handle() || !running) {
+		return sdrplay_api_NotInitialised;
+	}
+
+	running = 0;
+	pthread_join(thread, NULL);
+
+	free(tuners[0].samples);
+	free(tuners[1].samples);
+	memset(tuners, 0, sizeof(tuners));
+
+	return sdrplay_api_Success;
+}
+
+sdrplay_api_ErrT sdrplay_api_Update(
+	HANDLE dev, sdrplay_api_TunerSelectT tuner,
+	sdrplay_api_ReasonForUpdateT reasonForUpdate,
+	sdrplay_api_ReasonForUpdateExtension1T reasonForUpdateExt1) {
+	(void) reasonForUpdateExt1;
+
+	if (dev != stub_handle() || !running) {
+		return sdrplay_api_NotInitialised;
+	}
+
+	if (tuner != sdrplay_api_Tuner_A && tuner != sdrplay_api_Tuner_B) {
+		return sdrplay_api_InvalidParam;
+	}
+
+	/* The new parameters have already been written to the structures,
+	 * and are not reflected in the replayed samples */
+	(void) reasonForUpdate;
+
+	return sdrplay_api_Success;
+}
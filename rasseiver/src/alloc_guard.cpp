@@ -0,0 +1,94 @@
+#include "alloc_guard.hpp"
+
+#ifdef ALLOC_GUARD
+
+# include <atomic>
+
+# include <cerrno>
+# include <cstdio>
+# include <cstdlib>
+# include <malloc.h>
+
+extern "C" {
+	void *__libc_malloc(size_t size);
+	void *__libc_calloc(size_t count, size_t size);
+	void *__libc_realloc(void *ptr, size_t size);
+	void *__libc_memalign(size_t alignment, size_t size);
+}
+
+/**
+ * The amount of guards alive on the current thread.
+ */
+static thread_local int depth {0};
+
+/**
+ * The amount of allocations made while a guard was alive.
+ */
+static std::atomic<unsigned long> violations {0};
+
+static inline void check() {
+	if (depth > 0) {
+		violations.fetch_add(1, std::memory_order_relaxed);
+	}
+}
+
+extern "C" void *malloc(size_t size) {
+	check();
+	return __libc_malloc(size);
+}
+
+extern "C" void *calloc(size_t count, size_t size) {
+	check();
+	return __libc_calloc(count, size);
+}
+
+extern "C" void *realloc(void *ptr, size_t size) {
+	check();
+	return __libc_realloc(ptr, size);
+}
+
+extern "C" void *memalign(size_t alignment, size_t size) {
+	check();
+	return __libc_memalign(alignment, size);
+}
+
+extern "C" void *aligned_alloc(size_t alignment, size_t size) {
+	check();
+	return __libc_memalign(alignment, size);
+}
+
+extern "C" int posix_memalign(void **ptr, size_t alignment, size_t size) {
+	check();
+	*ptr = __libc_memalign(alignment, size);
+	return *ptr == nullptr && size > 0 ? ENOMEM : 0;
+}
+
+AllocGuard::AllocGuard() {
+	depth++;
+}
+
+AllocGuard::~AllocGuard() {
+	depth--;
+}
+
+static void report() {
+	unsigned long count {violations.load()};
+
+	std::fprintf(stderr, "Allocation guard: %lu allocations in real-time "
+		     "paths\n", count);
+
+	if (count > 0) {
+		std::_Exit(2);
+	}
+}
+
+/**
+ * Registers report() when the program starts.
+ */
+static struct Reporter {
+	Reporter() {
+		std::atexit(report);
+	}
+} reporter;
+
+#endif  /* ALLOC_GUARD */
@@ -0,0 +1,34 @@
+#ifndef __ILSIMU_RASSEIVER_ALLOC_GUARD_HPP
+# define __ILSIMU_RASSEIVER_ALLOC_GUARD_HPP
+
+/**
+ * Marks the current thread as being in a real-time path (eg. a device
+ * callback) while it is alive.  Real-time paths must not allocate memory.
+ *
+ * This only has an effect when the program is built with ALLOC_GUARD (cmake
+ * -DALLOC_GUARD=1).  In this case, malloc() and its siblings (hence operator
+ * new) are wrapped to count allocations made while a guard is alive on the
+ * calling thread.  The count is printed when the program exits, and the exit
+ * status is set to 2 if it is not zero.  See tools/alloc-check.sh.
+ *
+ * Otherwise, it does nothing and costs nothing.
+ */
+class AllocGuard {
+public:
+# ifdef ALLOC_GUARD
+	AllocGuard();
+	~AllocGuard();
+# else
+	// Not defaulted, to avoid unused variable warnings.
+	AllocGuard() {
+	}
+
+	~AllocGuard() {
+	}
+# endif  /* ALLOC_GUARD */
+
+	AllocGuard(AllocGuard const &) = delete;
+	AllocGuard &operator=(AllocGuard const &) = delete;
+};
+
+#endif  /* __ILSIMU_RASSEIVER_ALLOC_GUARD_HPP */
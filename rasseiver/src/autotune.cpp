@@ -0,0 +1,137 @@
+#include <fstream>
+#include <iomanip>
+#include <sstream>
+
+#include <cstdlib>
+#include <cstring>
+
+#include <sys/stat.h>
+
+#include "autotune.hpp"
+
+/**
+ * Hashes the coefficients of a filter with FNV-1a.
+ */
+static uint64_t filter_hash(Filter const &filter) {
+	uint64_t hash {0xcbf29ce484222325};
+
+	for (double h: filter) {
+		unsigned char bytes[sizeof(h)];
+
+		std::memcpy(bytes, &h, sizeof(h));
+
+		for (unsigned char byte: bytes) {
+			hash = (hash ^ byte) * 0x100000001b3;
+		}
+	}
+
+	return hash;
+}
+
+/**
+ * Returns the model of the CPU, as found in /proc/cpuinfo, or "unknown".
+ */
+static std::string cpu_model() {
+	std::ifstream cpuinfo {"/proc/cpuinfo"};
+	std::string line;
+
+	while (std::getline(cpuinfo, line)) {
+		if (line.compare(0, 10, "model name") == 0) {
+			return line.substr(line.find(':') + 2);
+		}
+	}
+
+	return "unknown";
+}
+
+/**
+ * Returns the path of the cache file.
+ *
+ * @param file The configured file, or an empty string for the default one.
+ * @param create Whether the directory of the default file is created.
+ */
+static std::string cache_path(std::string const &file, bool create) {
+	if (!file.empty()) {
+		return file;
+	}
+
+	std::string dir;
+
+	if (char const *cache = std::getenv("XDG_CACHE_HOME")) {
+		dir = cache;
+	} else if (char const *home = std::getenv("HOME")) {
+		dir = std::string {home} + "/.cache";
+	} else {
+		return "";
+	}
+
+	if (create) {
+		mkdir(dir.c_str(), 0755);
+		mkdir((dir + "/rasseiver").c_str(), 0755);
+	}
+
+	return dir + "/rasseiver/autotune";
+}
+
+std::string autotune_key(Filter const &filter, int step, size_t bufsize,
+			 std::string const &config) {
+	std::ostringstream key;
+
+	key << "filter=" << std::hex << std::setw(16) << std::setfill('0')
+	    << filter_hash(filter) << std::dec << " length=" << filter.size()
+	    << " decimation=" << step << " buffer=" << bufsize << " "
+	    << config << " cpu=" << cpu_model();
+
+	return key.str();
+}
+
+std::string autotune_cache_read(std::string const &file,
+				std::string const &key) {
+	std::ifstream cache {cache_path(file, false)};
+	std::string line;
+
+	// Each line is a key and the name of an engine, separated by a tab.
+	while (std::getline(cache, line)) {
+		const size_t tab {line.find('\t')};
+
+		if (tab != std::string::npos && line.compare(0, tab, key) == 0) {
+			return line.substr(tab + 1);
+		}
+	}
+
+	return "";
+}
+
+void autotune_cache_write(std::string const &file, std::string const &key,
+			  std::string const &name) {
+	const std::string path {cache_path(file, true)};
+	std::vector<std::string> lines;
+	std::string line;
+
+	if (path.empty()) {
+		return;
+	}
+
+	{
+		std::ifstream cache {path};
+
+		while (std::getline(cache, line)) {
+			if (line.compare(0, key.size() + 1, key + "\t") != 0) {
+				lines.push_back(line);
+			}
+		}
+	}
+
+	lines.push_back(key + "\t" + name);
+
+	std::ofstream cache {path, std::ios::trunc};
+
+	for (auto &it: lines) {
+		cache << it << "\n";
+	}
+
+	if (!cache) {
+		std::cerr << "Could not write the autotune cache \"" << path
+			  << "\"" << std::endl;
+	}
+}
@@ -0,0 +1,188 @@
+#ifndef __ILSIMU_RASSEIVER_AUTOTUNE_HPP
+# define __ILSIMU_RASSEIVER_AUTOTUNE_HPP
+
+# include <algorithm>
+# include <chrono>
+# include <iostream>
+# include <memory>
+# include <random>
+# include <string>
+# include <vector>
+
+# include "engine.hpp"
+
+/**
+ * Builds the key of a tuning in the cache: it identifies the filter (by a
+ * hash of its coefficients), the decimation factor, the size of the buffers,
+ * the CPU model, and the other parameters given by the caller.
+ *
+ * @param filter The filter.
+ * @param step The decimation factor.
+ * @param bufsize The size of the input buffers, in IQ samples.
+ * @param config Other parameters affecting the tuning.
+ */
+std::string autotune_key(Filter const &filter, int step, size_t bufsize,
+			 std::string const &config);
+
+/**
+ * Looks for a tuning in the cache.
+ *
+ * @param file The cache file.  If it is empty, the default location is used
+ *   ($XDG_CACHE_HOME/rasseiver/autotune or ~/.cache/rasseiver/autotune).
+ * @param key The key of the tuning.
+ * @returns The name of the chosen engine, or an empty string.
+ */
+std::string autotune_cache_read(std::string const &file,
+				std::string const &key);
+
+/**
+ * Stores a tuning in the cache, replacing the previous one with the same
+ * key.  Failures are reported, but are not fatal.
+ *
+ * @param file The cache file, or an empty string for the default location.
+ * @param key The key of the tuning.
+ * @param name The name of the chosen engine.
+ */
+void autotune_cache_write(std::string const &file, std::string const &key,
+			  std::string const &name);
+
+/**
+ * Chooses the fastest of several engines for a filter.
+ *
+ * Each engine filters the same buffers of synthetic samples (uniform noise at
+ * the full scale of the device).  Its outputs are compared to those of a
+ * double precision DirectEngine, and an engine whose outputs differ by more
+ * than half a unit (ie. half a step of the ADC, with a filter of unit gain)
+ * is discarded.  The fastest remaining engine is chosen.
+ *
+ * The choice is cached, so that later starts on the same machine with the
+ * same filter and parameters skip the measurements.
+ *
+ * @param engines The candidates, as returned by make_engines().
+ * @param filter The filter.
+ * @param bufsize The size of the input buffers, in IQ samples.
+ * @param max_value The max absolute value of the samples.
+ * @param cache The cache file, an empty string for the default location, or
+ *   "none" to disable the cache.
+ * @param config Other parameters affecting the tuning, part of the key.
+ * @returns The chosen engine.
+ */
+template<typename T>
+std::unique_ptr<FilterEngine<T>> autotune(
+	std::vector<std::unique_ptr<FilterEngine<T>>> engines,
+	Filter const &filter, size_t bufsize, int max_value,
+	std::string const &cache, std::string const &config) {
+	const int step {engines.front()->step()};
+	const std::string key {autotune_key(filter, step, bufsize, config)};
+	const bool use_cache {cache != "none"};
+
+	auto find = [&engines] (std::string const &name) {
+		return std::find_if(engines.begin(), engines.end(),
+				    [&name] (auto const &engine) {
+					    return engine->name() == name;
+				    });
+	};
+
+	if (engines.size() == 1) {
+		return std::move(engines.front());
+	}
+
+	if (use_cache) {
+		auto cached = find(autotune_cache_read(cache, key));
+
+		if (cached != engines.end()) {
+			std::cout << "Autotune: using the cached choice, the "
+				  << (*cached)->name() << " engine"
+				  << std::endl;
+			return std::move(*cached);
+		}
+	}
+
+	constexpr int rounds {16};
+	const size_t outputs {(bufsize * 2 / step + 1) * 2};
+	std::minstd_rand random {1};
+	std::uniform_int_distribution<int> noise {-max_value, max_value - 1};
+	std::vector<std::vector<T>> inputs (2, std::vector<T> (bufsize * 2));
+
+	for (auto &input: inputs) {
+		for (auto &value: input) {
+			value = static_cast<T> (noise(random));
+		}
+	}
+
+	// Filters the synthetic buffers, and returns the time taken by the
+	// fastest round.  The outputs of the last round are kept.
+	auto measure = [&] (FilterEngine<T> const &engine,
+			    std::vector<float> &output) {
+		CircularBuffer<T> buffer {bufsize * 2};
+		auto best = std::chrono::steady_clock::duration::max();
+		size_t pos {0};
+
+		output.resize(outputs);
+
+		for (int round = 0; round < rounds; round++) {
+			auto &input = inputs[round % inputs.size()];
+			SampleWriter writer {
+				SampleFormat::float32, 1,
+				reinterpret_cast<uint8_t *> (output.data())};
+
+			buffer.switch_buffer(input.data(), input.size());
+
+			auto start = std::chrono::steady_clock::now();
+			engine.apply(buffer, writer, pos);
+			writer.flush();
+			best = std::min(best, std::chrono::steady_clock::now() -
+					start);
+
+			pos %= buffer.size();
+			output.resize(writer.size() / sizeof(float));
+		}
+
+		return std::chrono::duration<double, std::milli> (best).count();
+	};
+
+	std::vector<float> reference, output;
+	size_t chosen {engines.size()};
+	double chosen_time {0};
+
+	measure(DirectEngine<T, double> {filter, step}, reference);
+	std::cout << "Autotune:";
+
+	for (size_t i = 0; i < engines.size(); i++) {
+		double time {measure(*engines[i], output)};
+		double error {0};
+
+		for (size_t k = 0; k < output.size(); k++) {
+			error = std::max(error, std::abs(static_cast<double> (
+							 output[k]) -
+						 reference[k]));
+		}
+
+		std::cout << " " << engines[i]->name() << " " << time << " ms";
+
+		if (output.size() != reference.size() || error > 0.5) {
+			std::cout << " (discarded, error " << error << ")";
+		} else if (chosen == engines.size() || time < chosen_time) {
+			chosen = i;
+			chosen_time = time;
+		}
+
+		std::cout << ",";
+	}
+
+	if (chosen == engines.size()) {
+		throw std::runtime_error {"No filtering engine gives correct "
+				"outputs"};
+	}
+
+	std::cout << " using the " << engines[chosen]->name() << " engine"
+		  << std::endl;
+
+	if (use_cache) {
+		autotune_cache_write(cache, key, engines[chosen]->name());
+	}
+
+	return std::move(engines[chosen]);
+}
+
+#endif  /* __ILSIMU_RASSEIVER_AUTOTUNE_HPP */
@@ -0,0 +1,109 @@
+#ifndef __ILSIMU_RASSEIVER_BLOCK_HPP
+# define __ILSIMU_RASSEIVER_BLOCK_HPP
+
+# include "meter.hpp"
+# include "page_allocator.hpp"
+# include "protocol.hpp"
+# include "sample_format.hpp"
+
+/**
+ * When the samples of a block were captured, and where they are in the
+ * stream.
+ *
+ * The layout of this structure is also its layout on the network (see
+ * protocol.hpp), so it must not contain any padding.
+ */
+struct Timing {
+	/**
+	 * The size of the record in bytes, and its version.
+	 */
+	uint16_t size {protocol_timing_size};
+	uint16_t version {protocol_timing_version};
+	uint32_t reserved {0};
+
+	/**
+	 * The number of the block.  It is incremented for every block, even
+	 * those dropped because the sender thread was late, so a gap means
+	 * that blocks were lost.
+	 */
+	uint64_t sequence {0};
+
+	/**
+	 * The index of the input IQ sample of the first output of the block,
+	 * counted from the first sample received from the device, including
+	 * the dropped samples.
+	 */
+	uint64_t sample {0};
+
+	/**
+	 * The amount of input IQ samples dropped by the device since it
+	 * started streaming.
+	 */
+	uint64_t dropped {0};
+
+	/**
+	 * When the input sample of the first output of the block was
+	 * captured, in nanoseconds since the epoch (CLOCK_REALTIME), and since
+	 * an unspecified point (CLOCK_MONOTONIC, the steady clock).  It is
+	 * estimated from the arrival of its buffer and the input rate.
+	 */
+	int64_t realtime {0};
+	int64_t monotonic {0};
+};
+
+static_assert(sizeof(Timing) == protocol_timing_size,
+	      "Timing must not be padded");
+
+/**
+ * A block of output samples, and the informations sent with it.
+ */
+struct Block {
+	/**
+	 * Creates a block able to hold `capacity' bytes of samples.
+	 *
+	 * @param capacity The size of the data buffer, in bytes.
+	 * @param allocator The allocator of the data buffer.
+	 */
+	Block(size_t capacity, PageAllocator<uint8_t> const &allocator):
+		data (capacity, allocator) {
+	}
+
+	/**
+	 * The samples.  Only the first `size' bytes are meaningful.
+	 */
+	PageVector<uint8_t> data;
+	size_t size {0};
+
+	SampleFormat format {SampleFormat::int16};
+	bool saturation {false};
+
+	/**
+	 * Whether `data' has been compressed with an Encoder or not.
+	 */
+	bool compressed {false};
+
+	/**
+	 * The statistics of the raw input.  Only sent if `has_metering' is
+	 * true.
+	 */
+	Metering metering {};
+	bool has_metering {false};
+
+	/**
+	 * The frequency the device was tuned to, in Hz.  Only sent if
+	 * `has_frequency' is true, ie. when the device scans several
+	 * frequencies.
+	 */
+	uint32_t frequency {0};
+	bool has_frequency {false};
+
+	/**
+	 * The timestamps and the position of the block.  They are also used
+	 * to measure the latency of the output, but are only sent if
+	 * `has_timing' is true.
+	 */
+	Timing timing {};
+	bool has_timing {false};
+};
+
+#endif  /* __ILSIMU_RASSEIVER_BLOCK_HPP */
@@ -0,0 +1,62 @@
+#include <stdexcept>
+
+#include <cerrno>
+
+#include "block_pool.hpp"
+
+BlockPool::BlockPool(size_t count, size_t capacity, int node):
+	numa_node {node}, free_blocks {count}, ready_blocks {count} {
+	blocks.reserve(count);
+
+	for (size_t i = 0; i < count; i++) {
+		blocks.emplace_back(capacity,
+				    PageAllocator<uint8_t> {"output", node});
+		free_blocks.push(&blocks.back());
+	}
+
+	if (sem_init(&available, 0, 0)) {
+		throw std::runtime_error {"sem_init() failed"};
+	}
+}
+
+BlockPool::~BlockPool() {
+	sem_destroy(&available);
+}
+
+Block *BlockPool::acquire() {
+	Block *block {free_blocks.pop()};
+
+	if (block == nullptr) {
+		dropped_blocks.fetch_add(1, std::memory_order_relaxed);
+	}
+
+	return block;
+}
+
+void BlockPool::submit(Block *block) {
+	// There are as many slots as blocks, so this cannot fail.
+	ready_blocks.push(block);
+	sem_post(&available);
+}
+
+Block *BlockPool::next() {
+	for (;;) {
+		while (sem_wait(&available) && errno == EINTR) {
+		}
+
+		Block *block {ready_blocks.pop()};
+
+		if (block != nullptr || closed) {
+			return block;
+		}
+	}
+}
+
+void BlockPool::release(Block *block) {
+	free_blocks.push(block);
+}
+
+void BlockPool::close() {
+	closed = true;
+	sem_post(&available);
+}
@@ -0,0 +1,181 @@
+#ifndef __ILSIMU_RASSEIVER_BLOCK_POOL_HPP
+# define __ILSIMU_RASSEIVER_BLOCK_POOL_HPP
+
+# include <atomic>
+# include <vector>
+
+# include <semaphore.h>
+
+# include "block.hpp"
+
+/**
+ * A bounded, lock-free, single producer and single consumer queue of
+ * pointers.
+ */
+template<typename T>
+class SpscRing {
+public:
+	SpscRing() = delete;
+
+	/**
+	 * Creates a ring able to contain `capacity' elements.
+	 *
+	 * @param capacity The maximum amount of elements in the ring.
+	 */
+	SpscRing(size_t capacity): slots (capacity + 1) {
+	}
+
+	SpscRing(SpscRing const &) = delete;
+	SpscRing &operator=(SpscRing const &) = delete;
+
+	/**
+	 * Adds an element to the ring.  Must only be called by the producer.
+	 *
+	 * @param value The element to add.
+	 * @returns false if the ring is full, true otherwise.
+	 */
+	bool push(T *value) {
+		const size_t t {tail.load(std::memory_order_relaxed)};
+		const size_t next {(t + 1) % slots.size()};
+
+		if (next == head.load(std::memory_order_acquire)) {
+			return false;
+		}
+
+		slots[t] = value;
+		tail.store(next, std::memory_order_release);
+
+		return true;
+	}
+
+	/**
+	 * Removes the oldest element of the ring.  Must only be called by the
+	 * consumer.
+	 *
+	 * @returns The element, or nullptr if the ring is empty.
+	 */
+	T *pop() {
+		const size_t h {head.load(std::memory_order_relaxed)};
+
+		if (h == tail.load(std::memory_order_acquire)) {
+			return nullptr;
+		}
+
+		T *value {slots[h]};
+		head.store((h + 1) % slots.size(), std::memory_order_release);
+
+		return value;
+	}
+
+private:
+	std::vector<T *> slots;
+
+	// Separated to avoid false sharing between the producer and the
+	// consumer.
+	std::atomic<size_t> head {0};
+	char padding[64 - sizeof(std::atomic<size_t>)];
+	std::atomic<size_t> tail {0};
+};
+
+/**
+ * A fixed set of blocks exchanged between a producer (the device callback)
+ * and a consumer (the sender thread).
+ *
+ * All blocks are allocated at construction.  The producer acquires a free
+ * block, fills it, and submits it; the consumer waits for the next submitted
+ * block, sends it, and releases it.  The producer never blocks: if no block
+ * is free, acquire() returns nullptr and the block is counted as dropped.
+ */
+class BlockPool {
+public:
+	BlockPool() = delete;
+
+	/**
+	 * Creates a pool.
+	 *
+	 * @param count The amount of blocks in the pool.
+	 * @param capacity The size of the data buffer of each block, in bytes.
+	 * @param node The NUMA node of the blocks, or -1.
+	 */
+	BlockPool(size_t count, size_t capacity, int node);
+
+	~BlockPool();
+
+	BlockPool(BlockPool const &) = delete;
+	BlockPool &operator=(BlockPool const &) = delete;
+
+	/**
+	 * Takes a free block.  Never blocks.
+	 *
+	 * @returns A block, or nullptr if none is free.  In this case, the
+	 *   dropped blocks counter is incremented.
+	 */
+	Block *acquire();
+
+	/**
+	 * Hands a filled block to the consumer.  Never blocks.
+	 *
+	 * @param block A block returned by acquire().
+	 */
+	void submit(Block *block);
+
+	/**
+	 * Waits for the next submitted block.
+	 *
+	 * @returns The block, or nullptr if the pool has been closed.
+	 */
+	Block *next();
+
+	/**
+	 * Gives a block back to the producer.
+	 *
+	 * @param block A block returned by next().
+	 */
+	void release(Block *block);
+
+	/**
+	 * Wakes up the consumer, and makes next() return nullptr once all
+	 * submitted blocks have been consumed.
+	 */
+	void close();
+
+	/**
+	 * Returns the amount of blocks dropped because no block was free.
+	 */
+	uint64_t dropped() const {
+		return dropped_blocks.load(std::memory_order_relaxed);
+	}
+
+	/**
+	 * Returns the amount of blocks of the pool.
+	 */
+	size_t size() const {
+		return blocks.size();
+	}
+
+	/**
+	 * Returns the size of the data buffer of each block, in bytes.
+	 */
+	size_t capacity() const {
+		return blocks.front().data.size();
+	}
+
+	/**
+	 * Returns the NUMA node of the blocks, or -1.
+	 */
+	int node() const {
+		return numa_node;
+	}
+
+private:
+	const int numa_node;
+	std::vector<Block> blocks;
+	SpscRing<Block> free_blocks;
+	SpscRing<Block> ready_blocks;
+
+	sem_t available;
+	std::atomic<bool> closed {false};
+	std::atomic<uint64_t> dropped_blocks {0};
+};
+
+#endif  /* __ILSIMU_RASSEIVER_BLOCK_POOL_HPP */
@@ -4,9 +4,11 @@
 # include <algorithm>
 # include <vector>
 
+# include "page_allocator.hpp"
+
 /**
  * A generic circular buffer structure.  It internally uses two
- * std::vector to store values.
+ * std::vector to store values, backed by huge pages when possible.
  *
  * One may access to an element part of the current buffer with an
  * index higher or equal to 0, and to an element part of the previous
@@ -34,8 +36,11 @@ public:
 	 * work session.
 	 *
 	 * @param count The amount of memory to allocate in each buffer.
+	 * @param allocator The allocator of the buffers.
 	 */
-	CircularBuffer(size_t count): previous (count), current (count) {
+	CircularBuffer(size_t count,
+		       PageAllocator<T> const &allocator = {"input"}):
+		previous (count, allocator), current (count, allocator) {
 	}
 
 	// No need for the copy constructor and the assignment operator.
@@ -45,14 +50,14 @@ public:
 	/**
 	 * Returns a reference to the previous buffer.
 	 */
-	std::vector<T> const &get_previous() const {
+	PageVector<T> const &get_previous() const {
 		return previous;
 	}
 
 	/**
 	 * Returns a reference to the current buffer.
 	 */
-	std::vector<T> const &get_current() const {
+	PageVector<T> const &get_current() const {
 		return current;
 	}
 
@@ -64,6 +69,9 @@ public:
 	 * exchanged with std::swap(), then the content of the current
 	 * buffer is overwritten with new_values.
 	 *
+	 * No memory is allocated as long as `count' is lower or equal to the
+	 * size given to the constructor.
+	 *
 	 * @param new_values The values to insert in the current buffer.
 	 * @param count The amount of values to insert in the buffer.
 	 */
@@ -72,10 +80,42 @@ public:
 		// swapped, and current's elements are overwritten.
 		std::swap(previous, current);
 
-		current.clear();
-		current.reserve(count);
+		// Both buffers have the same capacity, so resizing within it
+		// never reallocates.
+		current.resize(count);
+
+		std::copy_n(new_values, count, current.begin());
+	}
+
+	/**
+	 * Returns the buffer which becomes the current one at the next call to
+	 * switch_spare(), so that its values may be written in place, without
+	 * the copy of switch_buffer().  It holds as many values as the size
+	 * given to the constructor.
+	 */
+	T *spare() {
+		previous.resize(previous.capacity());
+		return previous.data();
+	}
+
+	/**
+	 * Switch the current buffer with the spare one, whose values have
+	 * already been written.
+	 *
+	 * @param count The amount of values written in the spare buffer.
+	 */
+	void switch_spare(size_t count) {
+		std::swap(previous, current);
+		current.resize(count);
+	}
 
-		std::copy_n(new_values, count, std::back_inserter(current));
+	/**
+	 * Sets every value of the current buffer to zero, without changing its
+	 * size, so that none of its samples is used as history by the next
+	 * buffer.  The spare buffer is left untouched.
+	 */
+	void clear() {
+		std::fill(current.begin(), current.end(), T {});
 	}
 
 	/**
@@ -86,7 +126,7 @@ public:
 	}
 
 private:
-	std::vector<T> previous, current;
+	PageVector<T> previous, current;
 };
 
 #endif  /* __ILSIMU_RASSEIVER_CIRCULAR_BUFFER_HPP */
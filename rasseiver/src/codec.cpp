@@ -0,0 +1,463 @@
+#include "codec.hpp"
+
+#include <algorithm>
+#include <initializer_list>
+
+/**
+ * The Rice parameter indicating that a partition is stored without Rice
+ * coding.
+ */
+static constexpr uint32_t escape_parameter {31};
+
+/**
+ * The highest order of the fixed predictors.
+ */
+static constexpr int max_order {4};
+
+/**
+ * Writes a bit stream, MSB first.
+ */
+class BitWriter {
+public:
+	BitWriter(uint8_t *output): output {output} {
+	}
+
+	/**
+	 * Appends the `n' lowest bits of `value' to the stream.
+	 *
+	 * @param value The bits to write.  Other bits must be cleared.
+	 * @param n The amount of bits to write, lower or equal to 32.
+	 */
+	void put(uint32_t value, int n) {
+		acc = (acc << n) | value;
+		bits += n;
+
+		while (bits >= 8) {
+			bits -= 8;
+			output[pos++] = static_cast<uint8_t> (acc >> bits);
+		}
+	}
+
+	/**
+	 * Pads the stream with zeros to a byte boundary.
+	 *
+	 * @returns The size of the stream, in bytes.
+	 */
+	size_t finish() {
+		if (bits > 0) {
+			put(0, 8 - bits);
+		}
+
+		return pos;
+	}
+
+private:
+	uint8_t *const output;
+	size_t pos {0};
+	uint64_t acc {0};
+	int bits {0};
+};
+
+/**
+ * Reads a bit stream written by a BitWriter.
+ *
+ * Errors (ie. reading past the end of the stream) are sticky: once one
+ * happened, failed() returns true and every read returns 0.
+ */
+class BitReader {
+public:
+	BitReader(uint8_t const *input, size_t size):
+		input {input}, size {size} {
+	}
+
+	/**
+	 * Reads `n' bits from the stream.
+	 *
+	 * @param n The amount of bits to read, lower or equal to 32.
+	 */
+	uint32_t get(int n) {
+		if (n == 0) {
+			return 0;
+		}
+
+		if (bits < n) {
+			refill();
+
+			if (bits < n) {
+				error = true;
+				return 0;
+			}
+		}
+
+		uint32_t value {static_cast<uint32_t> (acc >> (64 - n))};
+		acc <<= n;
+		bits -= n;
+
+		return value;
+	}
+
+	/**
+	 * Reads an unary-coded value, ie. the amount of zeros before the next
+	 * one.
+	 */
+	uint32_t get_unary() {
+		uint32_t zeros {0};
+
+		for (;;) {
+			if (bits == 0) {
+				refill();
+
+				if (bits == 0) {
+					error = true;
+					return 0;
+				}
+			}
+
+			int leading {acc == 0 ? 64 : __builtin_clzll(acc)};
+
+			if (leading >= bits) {
+				zeros += bits;
+				acc = 0;
+				bits = 0;
+			} else {
+				zeros += leading;
+				// Two shifts, as shifting by 64 is undefined.
+				acc <<= leading;
+				acc <<= 1;
+				bits -= leading + 1;
+
+				return zeros;
+			}
+		}
+	}
+
+	bool failed() const {
+		return error;
+	}
+
+private:
+	void refill() {
+		while (bits <= 56 && pos < size) {
+			acc |= static_cast<uint64_t> (input[pos++]) << (56 - bits);
+			bits += 8;
+		}
+	}
+
+	uint8_t const *const input;
+	const size_t size;
+	size_t pos {0};
+	uint64_t acc {0};
+	int bits {0};
+	bool error {false};
+};
+
+static inline uint32_t zigzag(int32_t r) {
+	return (static_cast<uint32_t> (r) << 1) ^ static_cast<uint32_t> (r >> 31);
+}
+
+static inline int32_t unzigzag(uint32_t u) {
+	return static_cast<int32_t> (u >> 1) ^ -static_cast<int32_t> (u & 1);
+}
+
+/**
+ * Selects the fixed predictor giving the smallest residuals for a channel.
+ *
+ * All orders are evaluated in the same pass, the same way FLAC does it.
+ *
+ * @param x The samples of the channel.
+ * @param n The amount of samples.
+ * @returns The order of the best predictor.
+ */
+static int select_order(int32_t const *x, size_t n) {
+	int64_t e0 {}, e1 {}, e2 {}, e3 {}, e4 {};
+
+	if (n <= max_order) {
+		return 0;
+	}
+
+#pragma omp simd reduction(+: e0, e1, e2, e3, e4)
+	for (size_t t = max_order; t < n; t++) {
+		int32_t r0 {x[t]};
+		int32_t r1 {x[t] - x[t - 1]};
+		int32_t r2 {x[t] - 2 * x[t - 1] + x[t - 2]};
+		int32_t r3 {x[t] - 3 * x[t - 1] + 3 * x[t - 2] - x[t - 3]};
+		int32_t r4 {x[t] - 4 * x[t - 1] + 6 * x[t - 2] -
+			4 * x[t - 3] + x[t - 4]};
+
+		e0 += r0 < 0 ? -r0 : r0;
+		e1 += r1 < 0 ? -r1 : r1;
+		e2 += r2 < 0 ? -r2 : r2;
+		e3 += r3 < 0 ? -r3 : r3;
+		e4 += r4 < 0 ? -r4 : r4;
+	}
+
+	int64_t errors[] {e0, e1, e2, e3, e4};
+
+	return static_cast<int> (std::min_element(std::begin(errors),
+						  std::end(errors)) -
+				 std::begin(errors));
+}
+
+/**
+ * Computes the zigzag-encoded residuals of a channel with a fixed predictor.
+ *
+ * @param x The samples of the channel.
+ * @param n The amount of samples.
+ * @param order The order of the predictor.
+ * @param u Where the n - order residuals are written.
+ */
+static void compute_residuals(int32_t const *x, size_t n, int order,
+			      uint32_t *u) {
+	switch (order) {
+	case 0:
+#pragma omp simd
+		for (size_t t = 0; t < n; t++) {
+			u[t] = zigzag(x[t]);
+		}
+		break;
+	case 1:
+#pragma omp simd
+		for (size_t t = 1; t < n; t++) {
+			u[t - 1] = zigzag(x[t] - x[t - 1]);
+		}
+		break;
+	case 2:
+#pragma omp simd
+		for (size_t t = 2; t < n; t++) {
+			u[t - 2] = zigzag(x[t] - 2 * x[t - 1] + x[t - 2]);
+		}
+		break;
+	case 3:
+#pragma omp simd
+		for (size_t t = 3; t < n; t++) {
+			u[t - 3] = zigzag(x[t] - 3 * x[t - 1] + 3 * x[t - 2] -
+					  x[t - 3]);
+		}
+		break;
+	case 4:
+#pragma omp simd
+		for (size_t t = 4; t < n; t++) {
+			u[t - 4] = zigzag(x[t] - 4 * x[t - 1] + 6 * x[t - 2] -
+					  4 * x[t - 3] + x[t - 4]);
+		}
+		break;
+	}
+}
+
+/**
+ * Returns the amount of bits needed to Rice code a partition with the
+ * parameter `k'.
+ */
+static uint64_t rice_cost(uint32_t const *u, size_t len, uint32_t k) {
+	uint64_t quotients {};
+
+#pragma omp simd reduction(+: quotients)
+	for (size_t t = 0; t < len; t++) {
+		quotients += u[t] >> k;
+	}
+
+	return len * (k + 1) + quotients;
+}
+
+/**
+ * Writes a partition of residuals, with the cheapest Rice parameter, or
+ * without Rice coding if it is cheaper.
+ */
+static void encode_partition(uint32_t const *u, size_t len, BitWriter &bits) {
+	uint64_t sum {};
+	uint32_t max {};
+
+#pragma omp simd reduction(+: sum) reduction(max: max)
+	for (size_t t = 0; t < len; t++) {
+		sum += u[t];
+		max = u[t] > max ? u[t] : max;
+	}
+
+	// The optimal parameter is close to log2 of the mean; its neighbours
+	// are checked too.
+	uint32_t guess {0};
+	while (guess < escape_parameter - 1 && (len << (guess + 1)) <= sum) {
+		guess++;
+	}
+
+	uint32_t k {guess};
+	uint64_t cost {rice_cost(u, len, k)};
+
+	for (uint32_t candidate: {guess - 1, guess + 1}) {
+		if (candidate < escape_parameter) {
+			uint64_t candidate_cost {rice_cost(u, len, candidate)};
+
+			if (candidate_cost < cost) {
+				k = candidate;
+				cost = candidate_cost;
+			}
+		}
+	}
+
+	uint32_t width {max == 0 ? 0u : 32u - __builtin_clz(max)};
+
+	if (5 + len * width < cost) {
+		bits.put(escape_parameter, 5);
+		bits.put(width, 5);
+
+		for (size_t t = 0; t < len; t++) {
+			bits.put(u[t], width);
+		}
+
+		return;
+	}
+
+	const uint32_t mask {(1u << k) - 1};
+
+	bits.put(k, 5);
+
+	for (size_t t = 0; t < len; t++) {
+		uint32_t quotient {u[t] >> k};
+		uint32_t low {u[t] & mask};
+
+		if (quotient + 1 + k <= 32) {
+			bits.put((1u << k) | low, quotient + 1 + k);
+		} else {
+			for (; quotient >= 32; quotient -= 32) {
+				bits.put(0, 32);
+			}
+
+			bits.put(1, quotient + 1);
+			bits.put(low, k);
+		}
+	}
+}
+
+Encoder::Encoder(size_t max_count):
+	channel (max_count / 2), residuals (max_count / 2) {
+}
+
+size_t Encoder::max_size(size_t count) {
+	// Header, predictor orders and warm-up samples, partition headers,
+	// and 20 bits per residual at most: the residuals of 16 bits values
+	// fit in 20 bits, and a partition is never bigger than when it is
+	// not Rice coded.
+	return 4 + 2 * (1 + max_order * 2) +
+		2 * (count / 2 / codec_partition_size + 1) * 2 +
+		count * 20 / 8 + 1;
+}
+
+size_t Encoder::encode(int16_t const *input, size_t count, uint8_t *output) {
+	const size_t n {count / 2};
+	BitWriter bits {output + 4};
+
+	for (int shift = 0; shift < 32; shift += 8) {
+		*output++ = static_cast<uint8_t> (n >> shift);
+	}
+
+	for (int c = 0; c < 2; c++) {
+		int32_t *x {channel.data()};
+		uint32_t *u {residuals.data()};
+
+#pragma omp simd
+		for (size_t t = 0; t < n; t++) {
+			x[t] = input[2 * t + c];
+		}
+
+		const int order {select_order(x, n)};
+		const size_t nresiduals {n > static_cast<size_t> (order) ?
+				n - order : 0};
+
+		bits.put(static_cast<uint32_t> (order), 3);
+
+		for (int t = 0; t < order; t++) {
+			bits.put(static_cast<uint16_t> (x[t]), 16);
+		}
+
+		compute_residuals(x, n, order, u);
+
+		for (size_t t = 0; t < nresiduals; t += codec_partition_size) {
+			encode_partition(u + t, std::min(codec_partition_size,
+							 nresiduals - t),
+					 bits);
+		}
+	}
+
+	return 4 + bits.finish();
+}
+
+ssize_t codec_decode(uint8_t const *input, size_t size, int16_t *output,
+		     size_t max_count) {
+	size_t n {0};
+
+	if (size < 4) {
+		return -1;
+	}
+
+	for (int shift = 0; shift < 32; shift += 8) {
+		n |= static_cast<size_t> (*input++) << shift;
+	}
+
+	if (n * 2 > max_count) {
+		return -1;
+	}
+
+	BitReader bits {input, size - 4};
+
+	for (int c = 0; c < 2; c++) {
+		int16_t *x {output + c};
+		int order {static_cast<int> (bits.get(3))};
+
+		if (order > max_order || static_cast<size_t> (order) > n) {
+			return -1;
+		}
+
+		for (int t = 0; t < order; t++) {
+			x[2 * t] = static_cast<int16_t> (bits.get(16));
+		}
+
+		for (size_t t = order; t < n && !bits.failed();) {
+			const size_t end {std::min(t + codec_partition_size, n)};
+			uint32_t k {bits.get(5)};
+			uint32_t width {k == escape_parameter ? bits.get(5) : 0};
+
+			for (; t < end && !bits.failed(); t++) {
+				uint32_t u;
+
+				if (k == escape_parameter) {
+					u = bits.get(width);
+				} else {
+					u = bits.get_unary() << k;
+					u |= bits.get(k);
+				}
+
+				int32_t r {unzigzag(u)};
+				int32_t prediction {};
+
+				switch (order) {
+				case 1:
+					prediction = x[2 * (t - 1)];
+					break;
+				case 2:
+					prediction = 2 * x[2 * (t - 1)] -
+						x[2 * (t - 2)];
+					break;
+				case 3:
+					prediction = 3 * x[2 * (t - 1)] -
+						3 * x[2 * (t - 2)] +
+						x[2 * (t - 3)];
+					break;
+				case 4:
+					prediction = 4 * x[2 * (t - 1)] -
+						6 * x[2 * (t - 2)] +
+						4 * x[2 * (t - 3)] -
+						x[2 * (t - 4)];
+					break;
+				}
+
+				x[2 * t] = static_cast<int16_t> (prediction + r);
+			}
+		}
+
+		if (bits.failed()) {
+			return -1;
+		}
+	}
+
+	return static_cast<ssize_t> (n * 2);
+}
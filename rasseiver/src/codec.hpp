@@ -0,0 +1,97 @@
+#ifndef __ILSIMU_RASSEIVER_CODEC_HPP
+# define __ILSIMU_RASSEIVER_CODEC_HPP
+
+# include <vector>
+
+# include <cstddef>
+# include <cstdint>
+
+# include <sys/types.h>
+
+/**
+ * A lossless codec for interleaved 16 bits IQ samples, in the style of FLAC.
+ *
+ * Each channel (I and Q) is predicted with one of the fixed polynomial
+ * predictors of order 0 to 4, and the residuals are Rice coded in partitions
+ * of `codec_partition_size' values, each with its own parameter.
+ *
+ * The encoded stream is made of:
+ *   * the amount of IQ samples, as a 32 bits little-endian integer;
+ *   * a bit stream (MSB first) containing, for the I channel then the Q
+ *     channel:
+ *       * the order of the predictor (3 bits);
+ *       * the first `order' samples (16 bits each, two's complement);
+ *       * for each partition of residuals, the Rice parameter (5 bits)
+ *         followed by the Rice codes of the zigzag-encoded residuals.  If the
+ *         parameter is 31, the residuals are not Rice coded: the parameter is
+ *         followed by a width (5 bits), and each zigzag-encoded residual is
+ *         stored on `width' bits.
+ *   * the bit stream is padded with zeros to a byte boundary.
+ *
+ * Both the encoder and the decoder are part of the rasscodec library, so that
+ * servers can decode the stream.
+ */
+
+/**
+ * The amount of residuals in a partition.
+ */
+constexpr size_t codec_partition_size {256};
+
+/**
+ * Compresses blocks of interleaved IQ samples.
+ *
+ * The encoder keeps its scratch buffers between calls, so no memory is
+ * allocated after its construction.
+ */
+class Encoder {
+public:
+	Encoder() = delete;
+
+	/**
+	 * Creates an encoder.
+	 *
+	 * @param max_count The maximum amount of values (I and Q) in a block.
+	 */
+	Encoder(size_t max_count);
+
+	Encoder(Encoder const &) = delete;
+	Encoder &operator=(Encoder const &) = delete;
+
+	/**
+	 * Compresses a block of samples.
+	 *
+	 * @param input The samples, with interleaved I and Q values.
+	 * @param count The amount of values in `input'.  It must be even, and
+	 *   lower or equal to the `max_count' parameter of the constructor.
+	 * @param output Where the compressed block is written.  It must be at
+	 *   least Encoder::max_size(count) bytes long.
+	 * @returns The size of the compressed block, in bytes.
+	 */
+	size_t encode(int16_t const *input, size_t count, uint8_t *output);
+
+	/**
+	 * Returns the maximum size of a compressed block of `count' values.
+	 *
+	 * @param count The amount of values (I and Q) to compress.
+	 */
+	static size_t max_size(size_t count);
+
+private:
+	std::vector<int32_t> channel;
+	std::vector<uint32_t> residuals;
+};
+
+/**
+ * Decompresses a block compressed by an Encoder.
+ *
+ * @param input The compressed block.
+ * @param size The size of `input', in bytes.
+ * @param output Where the interleaved IQ samples are written.
+ * @param max_count The size of `output', in values.
+ * @returns The amount of values (I and Q) written to `output', or -1 if the
+ *   block is malformed or does not fit in `output'.
+ */
+ssize_t codec_decode(uint8_t const *input, size_t size, int16_t *output,
+		     size_t max_count);
+
+#endif  /* __ILSIMU_RASSEIVER_CODEC_HPP */
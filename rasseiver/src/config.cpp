@@ -3,6 +3,7 @@
 #include <algorithm>
 #include <fstream>
 #include <iostream>
+#include <stdexcept>
 
 ConfigValue::ConfigValue(std::string value): value {std::move(value)} {
 }
@@ -128,3 +129,75 @@ void config_read_file(std::string const &file, ConfigMap &config) {
 			  << std::endl;
 	}
 }
+
+/**
+ * Check whether a line starts a section, and read its name.
+ *
+ * @param line The line to check.
+ * @param name Where the name of the section is stored, if it is one.
+ * @returns true if the line starts a section.
+ */
+static bool parse_section(std::string line, std::string &name) {
+	line = line.substr(0, line.find('#'));
+	trim(line);
+
+	if (line.size() < 2 || line.front() != '[' || line.back() != ']') {
+		return false;
+	}
+
+	name = line.substr(1, line.size() - 2);
+	trim(name);
+
+	return true;
+}
+
+std::vector<ConfigSection> config_read_sections(std::string const &file,
+						ConfigMap &config) {
+	std::ifstream configFile {file};
+	std::string line, name;
+	std::vector<ConfigSection> sections;
+	// Parameters of each section, applied on top of the global ones once
+	// the whole file has been read.
+	std::vector<ConfigMap> overrides;
+
+	if (configFile.fail()) {
+		throw std::runtime_error {"Failed to open file \"" + file + "\""};
+	}
+
+	while (std::getline(configFile, line)) {
+		if (parse_section(line, name)) {
+			sections.push_back({name, {}});
+			overrides.emplace_back();
+		} else if (sections.empty()) {
+			parse_line(line, config);
+		} else {
+			parse_line(line, overrides.back());
+		}
+	}
+
+	if (sections.empty()) {
+		sections.push_back({"", config});
+	}
+
+	for (size_t i = 0; i < overrides.size(); i++) {
+		for (auto const &key: config_global_keys) {
+			if (overrides[i].count(key) > 0) {
+				throw std::runtime_error {
+					"\"" + key + "\" applies to every "
+					"device, so it must be set before the "
+					"first section, not in [" +
+					sections[i].name + "]"};
+			}
+		}
+	}
+
+	for (size_t i = 0; i < overrides.size(); i++) {
+		sections[i].config = config;
+
+		for (auto &it: overrides[i]) {
+			sections[i].config[it.first] = it.second;
+		}
+	}
+
+	return sections;
+}
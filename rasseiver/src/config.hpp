@@ -3,6 +3,7 @@
 
 # include <map>
 # include <string>
+# include <vector>
 
 /**
  * Stores a value from the config file. It can then be converted to a double
@@ -47,12 +48,57 @@ using ConfigMap = std::map<std::string, ConfigValue>;
 const ConfigMap config_default {
 	{"device", ConfigValue {"airspy"}},
 	{"frequency", ConfigValue {"111100000"}}, // 111.1 MHz
+	{"scan", ConfigValue {""}}, // Eg. 109500000:500,110300000:500 (Hz:ms)
+	{"scan_settle", ConfigValue {"2"}}, // Buffers discarded after each hop
 	{"sample_rate", ConfigValue {"2500000"}}, // 2.5 MSPS
-	{"sample_type", ConfigValue {"int"}},
+	{"sample_type", ConfigValue {"int"}}, // Airspy, or real to convert to IQ here
+	{"packing", ConfigValue {"0"}}, // Airspy, 12 bits samples on the USB link
+	{"rspduo_tuner", ConfigValue {"a"}}, // Or b
+	{"rspduo_mode", ConfigValue {"single"}}, // Or dual, 2 MSPS on both tuners
+	{"gain_reduction", ConfigValue {"40"}}, // dB, RSPduo
+	{"lna_state", ConfigValue {"0"}}, // RSPduo, 0 for the highest gain
+	{"sync_check_interval", ConfigValue {"1000"}}, // ms, Airspy clock sync, 0 for none
+	{"stall_timeout", ConfigValue {"500"}}, // ms without data before a restart, 0 for none
 	{"decimation", ConfigValue {"60"}},
+	{"output_rate", ConfigValue {"0"}}, // Hz, resample instead of decimation
+	{"precision", ConfigValue {"double"}}, // Or float, q15, auto
+	{"autotune_cache", ConfigValue {""}}, // Or none, default in ~/.cache
+	{"filter_threads", ConfigValue {"1"}}, // Shared by all devices, 0 for all CPUs
+	{"filter_cpus", ConfigValue {""}}, // Eg. 2-5, to pin filtering threads
+	{"filter_priority", ConfigValue {"0"}}, // SCHED_FIFO priority, 0 for none
+	{"callback_cpus", ConfigValue {""}}, // CPUs of the device callback
+	{"callback_priority", ConfigValue {"0"}},
+	{"sender_cpus", ConfigValue {""}},
+	{"sender_priority", ConfigValue {"0"}},
+	{"lock_memory", ConfigValue {"0"}}, // Lock the memory in RAM
+	{"numa_node", ConfigValue {"-1"}}, // Of the buffers, -1 for the callback's
 	{"host", ConfigValue {"127.0.0.1"}},
 	{"port", ConfigValue {"10001"}},
+	{"send_buffer", ConfigValue {"0"}}, // Bytes, 0 for the kernel default
+	{"tcp_nodelay", ConfigValue {"1"}}, // Send the end of blocks at once
+	{"tcp_keepalive", ConfigValue {"0"}}, // Idle seconds before probes, 0 for none
+	{"tcp_user_timeout", ConfigValue {"0"}}, // ms unacknowledged before reconnecting
+	{"zerocopy", ConfigValue {"0"}}, // MSG_ZEROCOPY, for large blocks
+	{"metering", ConfigValue {"0"}}, // Send raw input statistics
+	{"timing", ConfigValue {"0"}}, // Send sequence numbers and timestamps
+	{"output_format", ConfigValue {"int16"}}, // int16, int8, float16, float32, ils
+	{"ils_period", ConfigValue {"100"}}, // ms, window of the ils format
+	{"output_scale", ConfigValue {"1"}},
+	{"compression", ConfigValue {"0"}}, // Lossless, int16 only
+	{"output_queue", ConfigValue {"8"}}, // Output blocks waiting to be sent
+	{"output_block_samples", ConfigValue {"0"}}, // 0 for a block per device buffer
+	{"output_block_ms", ConfigValue {"0"}}, // Or in ms, if output_block_samples=0
 	{"count", ConfigValue {"-1"}}, // For dummydevice
+	{"log", ConfigValue {"stderr"}}, // Or syslog, for the messages of threads
+};
+
+/**
+ * The parameters of the whole process, rather than of a device: they can only
+ * be set before the first section of a config file.
+ */
+const std::vector<std::string> config_global_keys {
+	"filter_threads", "filter_cpus", "filter_priority", "lock_memory",
+	"stall_timeout", "log",
 };
 
 /**
@@ -64,4 +110,33 @@ const ConfigMap config_default {
  */
 void config_read_file(std::string const &file, ConfigMap &config);
 
+/**
+ * A section of a config file, starting with a line containing its name between
+ * brackets (eg. "[north]"), and describing a device.
+ */
+struct ConfigSection {
+	std::string name;
+	ConfigMap config;
+};
+
+/**
+ * Parse the specified config file, which may describe several devices.
+ *
+ * Parameters found before the first section apply to every section, unless
+ * the section sets them itself.  If the file has no section, a single section
+ * without a name holds the whole configuration, so config files describing a
+ * single device are still valid.
+ *
+ * If the file cannot be opened, or if a section sets one of the
+ * config_global_keys, a std::runtime_error is thrown.
+ *
+ * @param file The file to read the configuration from.
+ * @param config The configuration on which every section is based, for
+ *   instance config_default.  Parameters found before the first section are
+ *   added to it.
+ * @returns The sections, in the order of the file.
+ */
+std::vector<ConfigSection> config_read_sections(std::string const &file,
+						ConfigMap &config);
+
 #endif  /* __ILSIMU_RASSEIVER_CONFIG_HPP */
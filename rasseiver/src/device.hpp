@@ -14,6 +14,8 @@ public:
 	 */
 	Device() = default;
 
+	virtual ~Device() = default;
+
 	Device(Device const &) = delete;
 	Device &operator=(Device const &) = delete;
 
@@ -29,6 +31,14 @@ public:
 	 */
 	virtual void set_gain(int gain) = 0;
 
+	/**
+	 * Tunes the device to another frequency.  This may be called while
+	 * receiving data, from another thread than the callback.
+	 *
+	 * @param frequency The frequency of the signal to sample, in Hz.
+	 */
+	virtual void set_frequency(unsigned int frequency) = 0;
+
 	/**
 	 * Stop receiving data from the device.
 	 */
@@ -45,6 +55,17 @@ public:
 	virtual int max_value() = 0;
 
 	virtual bool is_streaming() = 0;
+
+	/**
+	 * Closes the device, and opens it again with the same settings, to
+	 * recover from a stall.  This is called while it is not receiving
+	 * data.  If it cannot be opened again, a std::runtime_error is thrown.
+	 *
+	 * @returns false if this kind of device cannot be reopened.
+	 */
+	virtual bool reopen() {
+		return false;
+	}
 };
 
 /**
@@ -2,6 +2,8 @@
 
 #include <iostream>
 
+#include "log.hpp"
+
 #define AIRSPY_OPERATION(FN, ...)					\
 	do {								\
 		auto result {static_cast<airspy_error> (FN(__VA_ARGS__))}; \
@@ -24,6 +26,8 @@ Airspy::Airspy(uint64_t serial_num, unsigned int frequency,
 	       unsigned int sample_rate, airspy_sample_type sample_type) {
 	AIRSPY_OPERATION(airspy_open_sn, &device, serial_num);
 
+	by_serial = true;
+	serial = serial_num;
 	init_airspy(frequency, sample_rate, sample_type);
 }
 
@@ -44,23 +48,52 @@ uint64_t Airspy::get_serial_number() {
 }
 
 bool Airspy::is_streaming() {
-	return airspy_is_streaming(device);
+	// Closed if it could not be reopened.
+	return device != nullptr && airspy_is_streaming(device);
 }
 
 void Airspy::set_frequency(unsigned int frequency) {
 	AIRSPY_OPERATION(airspy_set_freq, device, frequency);
+	this->frequency = frequency;
 }
 
 void Airspy::set_sample_rate(unsigned int sample_rate) {
 	AIRSPY_OPERATION(airspy_set_samplerate, device, sample_rate);
+	this->sample_rate = sample_rate;
 }
 
 void Airspy::set_sample_type(airspy_sample_type sample_type) {
 	AIRSPY_OPERATION(airspy_set_sample_type, device, sample_type);
+	this->sample_type = sample_type;
 }
 
 void Airspy::set_gain(int gain) {
 	AIRSPY_OPERATION(airspy_set_linearity_gain, device, gain);
+	this->gain = gain;
+}
+
+void Airspy::set_packing(bool packing) {
+	AIRSPY_OPERATION(airspy_set_packing, device, packing);
+	this->packing = packing;
+}
+
+bool Airspy::reopen() {
+	const int current_gain {gain};
+
+	airspy_close(device);
+	device = nullptr;
+
+	if (by_serial) {
+		AIRSPY_OPERATION(airspy_open_sn, &device, serial);
+	} else {
+		AIRSPY_OPERATION(airspy_open, &device);
+	}
+
+	init_airspy(frequency, sample_rate, sample_type);
+	set_gain(current_gain);
+	set_packing(packing);
+
+	return true;
 }
 
 Airspy::~Airspy() {
@@ -73,15 +106,12 @@ Airspy::~Airspy() {
 /**
  * A callback to wrap the real process to apply.
  *
- * This functions checks if the Airspy is still synced with its clock, and calls
- * the process provided.
- *
- * To check if the Airspy is still synced, the register 0 is dumped.  If the 4th
- * bit is set, the device is still synced.  If not, the device is out of sync,
- * and a warning is printed to stderr.
-
- * Then, it converts the context parameter to a Process, and calls its method
- * apply().  This call should be inlined when the program is optimised.
+ * It converts the context parameter to the Airspy, and calls the method
+ * apply() of its Process, with the amount of samples dropped by libairspy
+ * before this transfer.  Real samples are converted to IQ samples first.
+ * This call should be inlined when the program is optimised.  Nothing else
+ * is done here: a control transfer to check the clock sync would delay the
+ * delivery of the samples, so it is done by the monitor thread.
  *
  * This function delegates the processing instead of doing itself, because if we
  * wanted to handle another device kind, we would have to duplicate the process
@@ -91,51 +121,147 @@ Airspy::~Airspy() {
  *
  * @param transfer The data received from the Airspy.
  */
-static int airspy_callback(airspy_transfer_t *transfer) {
-	// Dump register and check if the airspy is still synced.
-	uint8_t value;
-	auto result {static_cast<airspy_error> (
-			airspy_si5351c_read(transfer->device, 0, &value))};
+int Airspy::callback(airspy_transfer_t *transfer) {
+	auto *airspy {static_cast<Airspy *> (transfer->ctx)};
 
-	if (result != AIRSPY_SUCCESS) {
-		std::cerr << "Error: could not dump register." << std::endl;
-		std::cerr << airspy_error_name(result)
-			  << std::endl;
-	} else if (value & 0x10) {
-		std::cerr << "Warning: Airspy out of sync." << std::endl;
-	}
+	if (airspy->converter != nullptr) {
+		// Two real samples for each IQ sample.
+		auto *samples {static_cast<uint16_t *> (transfer->samples)};
 
-	if (transfer->dropped_samples > 0) {
-		std::cerr << "Dropped samples" << std::endl;
-	}
+		airspy->process->apply(
+			airspy->converter->convert(samples,
+						   transfer->sample_count),
+			transfer->sample_count, transfer->dropped_samples / 2);
+	} else {
+		auto *samples {static_cast<int16_t *> (transfer->samples)};
 
-	// Processing input buffer
-	// Get back the process and the samples.
-	auto *process {static_cast<Process<int16_t> *> (transfer->ctx)};
-	auto *samples {static_cast<int16_t *> (transfer->samples)};
-
-	process->apply(samples, transfer->sample_count * 2);
+		airspy->process->apply(samples, transfer->sample_count * 2,
+				       transfer->dropped_samples);
+	}
 
 	return 0;
 }
 
+void Airspy::set_sync_interval(std::chrono::milliseconds interval) {
+	sync_interval = interval;
+}
+
 void Airspy::receive(Process<int16_t> &process) {
-	AIRSPY_OPERATION(airspy_start_rx, device, airspy_callback,
-			 static_cast<void *> (&process));
+	this->process = &process;
+
+	// A new converter, as the samples of the previous stream are not
+	// contiguous with the next ones.
+	if (sample_type == AIRSPY_SAMPLE_UINT16_REAL) {
+		converter = std::make_unique<IqConverter> (buffer_size() * 2);
+	} else {
+		converter.reset();
+	}
+
+	AIRSPY_OPERATION(airspy_start_rx, device, callback,
+			 static_cast<void *> (this));
+
+	stopping = false;
+	monitor_thread = std::thread {&Airspy::monitor, this,
+				      std::cref(process)};
 }
 
 void Airspy::stop() {
+	if (monitor_thread.joinable()) {
+		{
+			std::lock_guard<std::mutex> lock {mutex};
+			stopping = true;
+		}
+
+		stopped.notify_one();
+		monitor_thread.join();
+
+		std::cout << "Airspy: " << checks << " sync checks, "
+			  << out_of_sync << " out of sync, " << failed_checks
+			  << " failed, " << dropped << " samples dropped"
+			  << std::endl;
+	}
+
 	airspy_stop_rx(device);
 }
 
+/**
+ * Checks the clock sync and the dropped samples of the Airspy every
+ * `sync_interval', until stop() is called.  Changes are reported as they are
+ * seen, and counted.
+ *
+ * @param process The process receiving the data of the Airspy.
+ */
+void Airspy::monitor(Process<int16_t> const &process) {
+	std::unique_lock<std::mutex> lock {mutex};
+	const auto interval = sync_interval > std::chrono::milliseconds {0} ?
+		sync_interval : std::chrono::milliseconds {1000};
+
+	while (!stopped.wait_for(lock, interval, [this] { return stopping; })) {
+		if (sync_interval > std::chrono::milliseconds {0}) {
+			check_sync();
+		}
+
+		const uint64_t total {process.dropped_samples()};
+
+		if (total != dropped) {
+			log_message(LogLevel::warning,
+				    "Airspy dropped %lu samples",
+				    static_cast<unsigned long> (
+					    total - dropped));
+			dropped = total;
+		}
+	}
+}
+
+/**
+ * Dumps the register 0 of the Si5351C.  If its 4th bit is set, the Airspy is
+ * out of sync with its clock.
+ */
+void Airspy::check_sync() {
+	uint8_t value;
+	auto result {static_cast<airspy_error> (
+			airspy_si5351c_read(device, 0, &value))};
+
+	checks++;
+
+	if (result != AIRSPY_SUCCESS) {
+		log_limited(check_errors, LogLevel::error,
+			    "Could not dump the Airspy register: %s",
+			    airspy_error_name(result));
+		failed_checks++;
+		return;
+	}
+
+	const bool now_synced {(value & 0x10) == 0};
+
+	if (!now_synced) {
+		out_of_sync++;
+	}
+
+	if (now_synced != synced) {
+		log_message(now_synced ? LogLevel::info : LogLevel::warning,
+			    now_synced ? "Airspy synced again" :
+			    "Airspy out of sync");
+		synced = now_synced;
+	}
+}
+
 size_t Airspy::buffer_size() {
 	// 262144 is from libairspy.  This is the size of the buffer in bytes.
 	// Divided by 2 for both IQ channels, then by the size of an int16_t
-	// (should be 2).  The final result should be equal to 65536.
-	return 262144 / 2 / sizeof(int16_t);
+	// (should be 2).  The final result should be equal to 65536.  Packed
+	// transfers are 6144 * 24 bytes of 12 bits samples, unpacked in
+	// 16 bits ones, so 49152 IQ samples.
+	return packing ? 6144 * 24 * 4 / 3 / 2 / sizeof(int16_t) :
+		262144 / 2 / sizeof(int16_t);
 }
 
 int Airspy::max_value() {
+	// The converter keeps the scale of the 12 bits ADC.
+	if (sample_type == AIRSPY_SAMPLE_UINT16_REAL) {
+		return 2048;
+	}
+
 	// 2^12
 	return 4069;
 }
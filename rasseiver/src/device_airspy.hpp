@@ -2,6 +2,14 @@
 # define __ILSIMU_RASSEIVER_DEVICE_AIRSPY_HPP
 
 # include "device.hpp"
+# include "iq_converter.hpp"
+# include "log.hpp"
+
+# include <chrono>
+# include <condition_variable>
+# include <memory>
+# include <mutex>
+# include <thread>
 
 # include <airspy.h>
 
@@ -13,6 +21,14 @@
  * airspy_device struct.  Mainly, this is an RAII class; when
  * allocated on the stack or with an unique_ptr, the device will
  * be automatically closed.
+ *
+ * While it is receiving data, a monitor thread checks that the Airspy is
+ * synced with its clock at a low rate, so that the callback only hands the
+ * buffers to the process.  Its counters are printed when the Airspy stops.
+ *
+ * With the AIRSPY_SAMPLE_UINT16_REAL sample type, libairspy hands the raw
+ * samples of the ADC, and they are converted to IQ samples by an IqConverter
+ * in the callback, instead of by the converter of libairspy.
  */
 class Airspy: public Device<int16_t> {
 public:
@@ -25,7 +41,8 @@ public:
 	 *
 	 * @param frequency The frequency of the signal to sample.
 	 * @param sample_rate Amount of samples the Airspy should take in a second.
-	 * @param sample_type Type of samples the Airspy should take.
+	 * @param sample_type Type of samples the Airspy should take:
+	 *   AIRSPY_SAMPLE_INT16_IQ or AIRSPY_SAMPLE_UINT16_REAL.
 	 */
 	Airspy(unsigned int frequency=111100000,
 	       unsigned int sample_rate=2500000,
@@ -38,7 +55,8 @@ public:
 	 * @param serial_num The serial number of the Airspy to open.
 	 * @param frequency The frequency of the signal to sample.
 	 * @param sample_rate Amount of samples the Airspy should take in a second.
-	 * @param sample_type Type of samples the Airspy should take.
+	 * @param sample_type Type of samples the Airspy should take:
+	 *   AIRSPY_SAMPLE_INT16_IQ or AIRSPY_SAMPLE_UINT16_REAL.
 	 */
 	Airspy(uint64_t serial_num,
 	       unsigned int frequency=111100000,
@@ -53,22 +71,75 @@ public:
 	uint64_t get_serial_number();
 	bool is_streaming() override;
 
-	void set_frequency(unsigned int frequency);
+	void set_frequency(unsigned int frequency) override;
 	void set_sample_rate(unsigned int sample_rate);
 	void set_sample_type(airspy_sample_type sample_type);
 	void set_gain(int gain) override;
 
+	/**
+	 * Enables or disables the packing of the samples on the USB link: 12
+	 * bits samples instead of 16 bits ones, so 25% less bandwidth.  The
+	 * buffers hold fewer samples then, so this must be called before the
+	 * process is created.
+	 *
+	 * @param packing Whether samples are packed.
+	 */
+	void set_packing(bool packing);
+
+	/**
+	 * Sets the interval at which the monitor thread checks the clock
+	 * sync.  It is applied by the next call to receive().
+	 *
+	 * @param interval The interval, or 0 to disable the checks.
+	 */
+	void set_sync_interval(std::chrono::milliseconds interval);
+
 	void receive(Process<int16_t> &process) override;
 	void stop() override;
 
+	/**
+	 * Closes the Airspy, and opens it again, by its serial number if it was
+	 * opened so.  Its frequency, sample rate, sample type and gain are
+	 * restored.
+	 */
+	bool reopen() override;
+
 	size_t buffer_size() override;
 	int max_value() override;
 
 private:
 	void init_airspy(unsigned int frequency, unsigned int sample_rate,
 			 airspy_sample_type sample_type);
+	void monitor(Process<int16_t> const &process);
+	void check_sync();
+
+	static int callback(airspy_transfer_t *transfer);
 
 	airspy_device *device {nullptr};
+
+	// Used by the callback.
+	Process<int16_t> *process {nullptr};
+	std::unique_ptr<IqConverter> converter;
+
+	// The settings restored by reopen().
+	bool by_serial {false};
+	uint64_t serial {0};
+	unsigned int frequency {0}, sample_rate {0};
+	airspy_sample_type sample_type {AIRSPY_SAMPLE_INT16_IQ};
+	int gain {1};
+	bool packing {false};
+
+	std::chrono::milliseconds sync_interval {1000};
+	std::thread monitor_thread;
+	std::mutex mutex;
+	std::condition_variable stopped;
+	bool stopping {false};
+
+	// Only used by the monitor thread, then by stop().
+	uint64_t checks {0}, out_of_sync {0}, failed_checks {0};
+	uint64_t dropped {0};
+	bool synced {true};
+	LogLimit check_errors {std::chrono::seconds {10}};
 };
 
 #endif  /* __ILSIMU_RASSEIVER_DEVICE_AIRSPY_HPP */
@@ -27,6 +27,10 @@ public:
 		(void) gain;
 	};
 
+	void set_frequency(unsigned int frequency) override {
+		(void) frequency;
+	};
+
 	void receive(Process<int16_t> &process) override;
 	void stop() override;
 
@@ -1,312 +1,715 @@
 #include "device_rspduo.hpp"
 
+#include <algorithm>
+#include <atomic>
 #include <iostream>
+#include <map>
+#include <mutex>
+#include <stdexcept>
+#include <thread>
+
+#include "log.hpp"
 
 #define RSPDUO_OPERATION(FN, ...)					\
 	do {								\
 		auto result {static_cast<sdrplay_api_ErrT> (FN(__VA_ARGS__))}; \
-		if (result != sdrplay_api_Success) {				\
+		if (result != sdrplay_api_Success) {			\
 			std::cerr << #FN "() failed: "			\
-				  << sdrplay_api_GetErrorString(result)		\
+				  << sdrplay_api_GetErrorString(result)	\
 				  << std::endl;				\
-			throw std::runtime_error {sdrplay_api_GetErrorString(result)}; \
+			throw std::runtime_error {			\
+				sdrplay_api_GetErrorString(result)};	\
 		}							\
 	} while (0)
 
-RSPDuo::RSPDuo(unsigned int frequency, unsigned int sample_rate) {
+/**
+ * The size of the buffers handed to the process, in IQ samples: 33 ms at
+ * 2 MSPS.
+ */
+static constexpr size_t rspduo_buffer_size {65536};
 
-	float ver {};
+/**
+ * The only sample rate of the tuners in dual tuner mode.
+ */
+static constexpr unsigned int rspduo_dual_rate {2000000};
 
-	unsigned int nb;
+/**
+ * Locks the API while devices are enumerated and selected, as advised by
+ * SDRplay.
+ */
+class RSPDuoApiLock {
+public:
+	RSPDuoApiLock() {
+		RSPDUO_OPERATION(sdrplay_api_LockDeviceApi,);
+	}
 
-	// Open API
-	RSPDUO_OPERATION(sdrplay_api_Open,);
+	~RSPDuoApiLock() {
+		sdrplay_api_UnlockDeviceApi();
+	}
 
+	RSPDuoApiLock(RSPDuoApiLock const &) = delete;
+	RSPDuoApiLock &operator=(RSPDuoApiLock const &) = delete;
+};
 
-	// Enable debug logging output
-	RSPDUO_OPERATION(sdrplay_api_DebugEnable,nullptr,sdrplay_api_DbgLvl_Verbose);
+/**
+ * The stream of a tuner, from the callback of the API to the process.
+ */
+struct RSPDuoStream {
+	// Set by receive(), cleared by stop().
+	std::atomic<Process<int16_t> *> process {nullptr};
+
+	// Set while the callback uses the process, so that stop() waits for
+	// it.
+	std::atomic<bool> busy {false};
+
+	// Only used by the callback while the process is set.
+	int16_t *buffer {nullptr};
+	size_t filled {0};
+	uint64_t dropped {0};
+
+	bool claimed {false};
+};
+
+/**
+ * An RSPduo selected in the API, shared by the instances of RSPDuo using its
+ * tuners.  The API streams both tuners of an RSPduo in dual tuner mode from
+ * a single Init(), so it is initialised when the first tuner starts
+ * streaming, and uninitialised when the last one stops.
+ */
+class RSPDuoHandle {
+public:
+	RSPDuoHandle() = delete;
+
+	/**
+	 * Opens the API and selects an RSPduo.
+	 *
+	 * @param serial The serial number of the RSPduo, or an empty string
+	 *   for the first one available.
+	 * @param dual Whether to select the dual tuner mode.
+	 * @param tuner The tuner, in single tuner mode.
+	 * @param sample_rate The sample rate, in single tuner mode.
+	 */
+	RSPDuoHandle(std::string const &serial, bool dual,
+		     sdrplay_api_TunerSelectT tuner, unsigned int sample_rate);
+
+	/**
+	 * Stops streaming, releases the RSPduo, and closes the API.
+	 */
+	~RSPDuoHandle();
+
+	RSPDuoHandle(RSPDuoHandle const &) = delete;
+	RSPDuoHandle &operator=(RSPDuoHandle const &) = delete;
+
+	/**
+	 * Returns the handle of an RSPduo for a tuner.  In dual tuner mode,
+	 * the RSPduo is shared by the tuners opened with the same serial
+	 * number.
+	 *
+	 * @param serial The serial number of the RSPduo, or an empty string
+	 *   for the first one available.
+	 * @param dual Whether the RSPduo is in dual tuner mode.
+	 * @param tuner The tuner to claim.
+	 * @param sample_rate The sample rate of the tuner.
+	 */
+	static std::shared_ptr<RSPDuoHandle> open(
+		std::string const &serial, bool dual,
+		sdrplay_api_TunerSelectT tuner, unsigned int sample_rate);
+
+	/**
+	 * Returns the parameters of a tuner, to be applied with update().
+	 */
+	sdrplay_api_RxChannelParamsT &channel(sdrplay_api_TunerSelectT tuner) {
+		return *(tuner == sdrplay_api_Tuner_B ? params->rxChannelB :
+			 params->rxChannelA);
+	}
 
-	// Check API versions match
-	RSPDUO_OPERATION(sdrplay_api_ApiVersion,&ver);
+	/**
+	 * Applies the parameters of a tuner, if it is streaming.  Otherwise,
+	 * they are applied by Init().
+	 *
+	 * @param tuner The tuner.
+	 * @param reason What was changed.
+	 */
+	void update(sdrplay_api_TunerSelectT tuner,
+		    sdrplay_api_ReasonForUpdateT reason);
+
+	/**
+	 * Releases the RSPduo, and selects it again by its serial number,
+	 * with the same parameters.  If a tuner is still handing its samples
+	 * to a process, for instance the other one in dual tuner mode, it
+	 * streams again.  If the RSPduo cannot be selected, a
+	 * std::runtime_error is thrown.
+	 */
+	void reopen();
+
+	/**
+	 * Starts handing the samples of a tuner to a process.
+	 */
+	void start(sdrplay_api_TunerSelectT tuner, Process<int16_t> &process);
+
+	/**
+	 * Stops handing the samples of a tuner to its process.  When it
+	 * returns, the process is not used anymore.
+	 */
+	void stop(sdrplay_api_TunerSelectT tuner);
+
+	/**
+	 * Stops a tuner, and lets another instance of RSPDuo open it.
+	 */
+	void release(sdrplay_api_TunerSelectT tuner);
+
+	bool is_streaming(sdrplay_api_TunerSelectT tuner) {
+		return streaming.load(std::memory_order_relaxed) &&
+			stream(tuner).process.load(
+				std::memory_order_relaxed) != nullptr;
+	}
 
-	if (ver != SDRPLAY_API_VERSION){
-		printf("API version don't match (local=%.2f dll=%.2f)\n", SDRPLAY_API_VERSION, ver);
+private:
+	void open_device();
+	void close_device();
+	void select();
+	void configure();
+	void init();
+	void claim(sdrplay_api_TunerSelectT tuner);
 
+	RSPDuoStream &stream(sdrplay_api_TunerSelectT tuner) {
+		return streams[tuner == sdrplay_api_Tuner_B];
 	}
-	// Lock API
-	sdrplay_api_LockDeviceApi();
-
-	// Fetch list of available devices
-	RSPDUO_OPERATION(sdrplay_api_GetDevices,devs,&nb,sizeof(devs)/(sizeof(sdrplay_api_DeviceT)));
 
+	static void stream_a(short *xi, short *xq,
+			     sdrplay_api_StreamCbParamsT *params,
+			     unsigned int count, unsigned int reset,
+			     void *context);
+	static void stream_b(short *xi, short *xq,
+			     sdrplay_api_StreamCbParamsT *params,
+			     unsigned int count, unsigned int reset,
+			     void *context);
+	static void event(sdrplay_api_EventT id,
+			  sdrplay_api_TunerSelectT tuner,
+			  sdrplay_api_EventParamsT *params, void *context);
+	static void deliver(RSPDuoStream &stream, short const *xi,
+			    short const *xq, unsigned int count, bool reset);
+
+	// The serial number is the one of the RSPduo once it is selected, so
+	// that reopen() finds the same one.
+	std::string serial;
+	const bool dual;
+	const sdrplay_api_TunerSelectT tuner;
+	const unsigned int sample_rate;
+
+	sdrplay_api_DeviceT device {};
+	sdrplay_api_DeviceParamsT *params {nullptr};
+	bool opened {false}, selected {false};
+
+	// The parameters of the tuners, restored by reopen().
+	sdrplay_api_RxChannelParamsT channels[2] {};
+
+	// Protects the API calls below, and the claims.
+	std::mutex mutex;
+	bool initialised {false};
+	std::atomic<bool> streaming {false};
+
+	RSPDuoStream streams[2];
+	LogLimit overloads {std::chrono::seconds {10}};
+};
+
+/**
+ * The handles of the RSPduos in dual tuner mode, by serial number.
+ */
+static std::mutex handles_mutex;
+static std::map<std::string, std::weak_ptr<RSPDuoHandle>> handles;
+
+RSPDuoHandle::RSPDuoHandle(std::string const &serial, bool dual,
+			   sdrplay_api_TunerSelectT tuner,
+			   unsigned int sample_rate):
+	serial {serial}, dual {dual}, tuner {tuner},
+	sample_rate {sample_rate} {
+	open_device();
+	this->serial = device.SerNo;
+
+	std::cout << "Opened RSPduo " << device.SerNo
+		  << (dual ? " in dual tuner mode" : " in single tuner mode")
+		  << std::endl;
+}
 
-	printf("MaxDevs=%lu NumDevs=%d\n", sizeof(devs) / sizeof(sdrplay_api_DeviceT), nb);
-	if (nb> 0)
-	{
-		for (i = 0; i < static_cast<int>(nb); i++)
-		{
-			if (devs[i].hwVer == SDRPLAY_RSPduo_ID)
-				std::cout
-				<< "Dev"
-				<< i
-				<< ": SerNo="
-				<< devs[i].SerNo
-				<< " hwVer="
-				<< devs[i].hwVer
-				<< " tuner=0x"
-				<<  devs[i].tuner
-				<<  "x rspDuoMode= "
-				<< devs[i].rspDuoMode
-				<< std::endl;
+RSPDuoHandle::~RSPDuoHandle() {
+	if (selected) {
+		std::cout << "Closing RSPduo " << device.SerNo << std::endl;
+	}
 
+	close_device();
+}
 
-			else
-			printf("Dev%d: SerNo=%s hwVer=%d tuner=0x%.2x\n", i, devs[i].SerNo,
-				devs[i].hwVer, devs[i].tuner);
-		}
+/**
+ * Opens the API, then selects and configures the RSPduo.  On failure, the
+ * API is closed again.
+ */
+void RSPDuoHandle::open_device() {
+	float version {0};
 
+	RSPDUO_OPERATION(sdrplay_api_Open,);
+	opened = true;
 
+	try {
+		RSPDUO_OPERATION(sdrplay_api_ApiVersion, &version);
 
-		// Pick first RSPduo
-		for (i = 0; i < (int)ndev; i++){
-			if (devs[i].hwVer == SDRPLAY_RSPduo_ID)
-			{
-				chosenIdx = i;
-					break;
-			}
+		if (version != SDRPLAY_API_VERSION) {
+			throw std::runtime_error {
+				"The SDRplay API service is version " +
+				std::to_string(version) + ", not " +
+				std::to_string(SDRPLAY_API_VERSION)};
 		}
 
-		// Choose device
-		printf("chosenDevice = %d\n", chosenIdx);
-		chosenDevice = &devs[chosenIdx];
-
-		// If chosen device is an RSPduo, assign additional fields
-		if (chosenDevice->hwVer == SDRPLAY_RSPduo_ID)
-		{
-		// If master device is available, select device as master
-		if (chosenDevice->rspDuoMode & sdrplay_api_RspDuoMode_Master)
-		{
-		// Select tuner based on user input (or default to TunerA)
-		chosenDevice->tuner = sdrplay_api_Tuner_A;
-		if (reqTuner == 1)
-		chosenDevice->tuner = sdrplay_api_Tuner_B;
-		// Set operating mode
-		if (!master_slave) // Single tuner mode
-		{
-		chosenDevice->rspDuoMode = sdrplay_api_RspDuoMode_Single_Tuner;
-		printf("Dev%d: selected rspDuoMode=0x%.2x tuner=0x%.2x\n", chosenIdx,
-		chosenDevice->rspDuoMode, chosenDevice->tuner);
-		}
-		else
-		{
-		chosenDevice->rspDuoMode = sdrplay_api_RspDuoMode_Master;
-		// Need to specify sample frequency in master/slave mode
-		chosenDevice->rspDuoSampleFreq = 6000000.0;
-		printf("Dev%d: selected rspDuoMode=0x%.2x tuner=0x%.2x rspDuoSampleFreq=%.1f\n",
-		chosenIdx, chosenDevice->rspDuoMode,
-		chosenDevice->tuner, chosenDevice->rspDuoSampleFreq);
-		}
-		}
-		else // Only slave device available
-		{
-		// Shouldn't change any parameters for slave device
-		}
-		}
+		select();
+		configure();
+	} catch (...) {
+		close_device();
+		throw;
 	}
+}
 
+/**
+ * Stops streaming, releases the RSPduo, and closes the API, as far as they
+ * were done.
+ */
+void RSPDuoHandle::close_device() {
+	if (initialised) {
+		sdrplay_api_Uninit(device.dev);
+		initialised = false;
+		streaming = false;
+	}
 
+	if (selected) {
+		sdrplay_api_ReleaseDevice(&device);
+		selected = false;
+	}
 
+	if (opened) {
+		sdrplay_api_Close();
+		opened = false;
+	}
+}
 
-	if (devs[0].hwVer == SDRPLAY_RSPduo_ID)
-		std::cout << "Dev:0" << " SerNo=" << devs[0].SerNo << " hwVer=" <<devs[0].hwVer<<
-			     " tuner=0x"<< devs[0].tuner<< "x rspDuoMode=0x"<<devs[0].rspDuoMode<< "\n";
+std::shared_ptr<RSPDuoHandle> RSPDuoHandle::open(
+	std::string const &serial, bool dual, sdrplay_api_TunerSelectT tuner,
+	unsigned int sample_rate) {
+	if (tuner != sdrplay_api_Tuner_A && tuner != sdrplay_api_Tuner_B) {
+		throw std::runtime_error {"Unknown RSPduo tuner"};
+	}
 
-	switch (devs[0].rspDuoMode) {
+	std::shared_ptr<RSPDuoHandle> handle;
 
-	case  sdrplay_api_RspDuoMode_Slave:
-		std::cout << "Mode Slave" << std::endl;break;
-	case sdrplay_api_RspDuoMode_Master :
-		std::cout << "Mode Master" << std::endl;break;
-	case sdrplay_api_RspDuoMode_Dual_Tuner :
-		std::cout << "Mode Dual Tuner" << std::endl;break;
-	case sdrplay_api_RspDuoMode_Single_Tuner :
-		std::cout << "Mode Single Tuner" << std::endl;break;
-	case sdrplay_api_RspDuoMode_Unknown :
-		std::cout << "Unknown" << std::endl;break;
+	if (!dual) {
+		handle = std::make_shared<RSPDuoHandle> (serial, dual, tuner,
+							 sample_rate);
+		handle->claim(tuner);
+		return handle;
+	}
 
-	default : std::cout << "unknown++" << std::endl;
+	if (sample_rate != rspduo_dual_rate) {
+		throw std::runtime_error {
+			"The sample rate of an RSPduo in dual tuner mode "
+			"is 2000000"};
+	}
 
+	std::lock_guard<std::mutex> lock {handles_mutex};
 
+	handle = handles[serial].lock();
 
+	if (handle == nullptr) {
+		handle = std::make_shared<RSPDuoHandle> (serial, dual, tuner,
+							 sample_rate);
+		handles[serial] = handle;
 	}
-	sample_rate ++;
-	frequency ++;
+
+	handle->claim(tuner);
+	return handle;
 }
 
-void RSPDuo::init_RSPDuo(unsigned int frequency, unsigned int sample_rate)
-{
-	(void) frequency;
-	(void) sample_rate;
+/**
+ * Selects the first RSPduo which has the serial number, if any, and can run
+ * in the mode.
+ */
+void RSPDuoHandle::select() {
+	RSPDuoApiLock lock;
+	sdrplay_api_DeviceT devices[SDRPLAY_MAX_DEVICES];
+	unsigned int count {0}, i;
+
+	RSPDUO_OPERATION(sdrplay_api_GetDevices, devices, &count,
+			 SDRPLAY_MAX_DEVICES);
+
+	for (i = 0; i < count; i++) {
+		if (devices[i].hwVer != SDRPLAY_RSPduo_ID ||
+		    (!serial.empty() && serial != devices[i].SerNo)) {
+			continue;
+		}
 
-}
+		// A tuner may already be used by another application.
+		if (dual ? !(devices[i].rspDuoMode &
+			     sdrplay_api_RspDuoMode_Dual_Tuner) :
+		    !(devices[i].rspDuoMode &
+		      sdrplay_api_RspDuoMode_Single_Tuner) ||
+		    !(devices[i].tuner & tuner)) {
+			continue;
+		}
 
-void RSPDuo::set_gain(int gain)
-{
-	gain ++;
-}
+		device = devices[i];
+		break;
+	}
 
-void RSPDuo::receive(Process<int16_t> &process)
-{
-	sdrplay_api_ErrT err;
-	if ((err = sdrplay_api_Init(chosenDevice->dev, &cbFns, static_cast<void *>(&process) )) != sdrplay_api_Success)
-	{printf("sdrplay_api_Init failed %s\n", sdrplay_api_GetErrorString(err));
+	if (i == count) {
+		throw std::runtime_error {
+			serial.empty() ? "No RSPduo available" :
+			"RSPduo " + serial + " not available"};
+	}
 
+	if (dual) {
+		device.rspDuoMode = sdrplay_api_RspDuoMode_Dual_Tuner;
+		device.tuner = sdrplay_api_Tuner_Both;
+		device.rspDuoSampleFreq = 6000000;
+	} else {
+		device.rspDuoMode = sdrplay_api_RspDuoMode_Single_Tuner;
+		device.tuner = tuner;
+	}
 
+	RSPDUO_OPERATION(sdrplay_api_SelectDevice, &device);
+	selected = true;
 }
-}
-void RSPDuo::stop()
-{
 
-}
+/**
+ * Sets the sample rate, the IF and the bandwidth of the tuners, and disables
+ * the AGC, so that the gain is the one set.
+ *
+ * In single tuner mode, the samples are at zero IF, and the bandwidth is the
+ * largest one which the sample rate holds.  In dual tuner mode, the ADC runs
+ * at 6 MHz with an IF of 1.62 MHz, and the API converts the samples to zero
+ * IF at 2 MSPS.
+ */
+void RSPDuoHandle::configure() {
+	static const sdrplay_api_Bw_MHzT bandwidths[] {
+		sdrplay_api_BW_8_000, sdrplay_api_BW_7_000,
+		sdrplay_api_BW_6_000, sdrplay_api_BW_5_000,
+		sdrplay_api_BW_1_536, sdrplay_api_BW_0_600,
+		sdrplay_api_BW_0_300, sdrplay_api_BW_0_200,
+	};
+	sdrplay_api_Bw_MHzT bandwidth {sdrplay_api_BW_1_536};
+
+	RSPDUO_OPERATION(sdrplay_api_GetDeviceParams, device.dev, &params);
+
+	if (!dual) {
+		if (params->devParams != nullptr) {
+			params->devParams->fsFreq.fsHz = sample_rate;
+		}
 
-size_t RSPDuo::buffer_size()
-{
-	size_t t {};
-	return t;
-}
-int RSPDuo::max_value()
-{
-	int i{};
-	return i;
-}
+		// The values are in kHz.
+		bandwidth = sdrplay_api_BW_0_200;
 
-bool RSPDuo::is_streaming()
-{
-	return true;
-}
+		for (auto bw: bandwidths) {
+			if (static_cast<unsigned int> (bw) * 1000 <=
+			    sample_rate) {
+				bandwidth = bw;
+				break;
+			}
+		}
+	}
 
-RSPDuo::~RSPDuo()
-{
+	for (auto *channel: {params->rxChannelA, params->rxChannelB}) {
+		if (channel == nullptr) {
+			continue;
+		}
 
+		channel->tunerParams.ifType = dual ? sdrplay_api_IF_1_620 :
+			sdrplay_api_IF_Zero;
+		channel->tunerParams.bwType = bandwidth;
+		channel->ctrlParams.agc.enable = sdrplay_api_AGC_DISABLE;
+	}
 }
-/*
-Airspy::Airspy(uint64_t serial_num, unsigned int frequency,
-	       unsigned int sample_rate, airspy_sample_type sample_type) {
-	AIRSPY_OPERATION(airspy_open_sn, &device, serial_num);
 
-	init_airspy(frequency, sample_rate, sample_type);
-}
+void RSPDuoHandle::claim(sdrplay_api_TunerSelectT tuner) {
+	std::lock_guard<std::mutex> lock {mutex};
 
-void Airspy::init_airspy(unsigned int frequency, unsigned int sample_rate,
-			 airspy_sample_type sample_type) {
-	set_frequency(frequency);
-	set_sample_rate(sample_rate);
-	set_sample_type(sample_type);
-	set_gain(1);
+	if (stream(tuner).claimed) {
+		throw std::runtime_error {
+			std::string {"The tuner "} +
+			(tuner == sdrplay_api_Tuner_B ? "B" : "A") +
+			" of the RSPduo is already used"};
+	}
+
+	stream(tuner).claimed = true;
 }
 
-uint64_t Airspy::get_serial_number() {
-	airspy_read_partid_serialno_t partid;
-	AIRSPY_OPERATION(airspy_board_partid_serialno_read, device, &partid);
+void RSPDuoHandle::update(sdrplay_api_TunerSelectT tuner,
+			  sdrplay_api_ReasonForUpdateT reason) {
+	std::lock_guard<std::mutex> lock {mutex};
 
-	return static_cast<uint64_t> (partid.serial_no[2]) << 32 |
-		partid.serial_no[3];
+	if (initialised) {
+		RSPDUO_OPERATION(sdrplay_api_Update, device.dev, tuner, reason,
+				 sdrplay_api_Update_Ext1_None);
+	}
 }
 
-bool Airspy::is_streaming() {
-	return airspy_is_streaming(device);
-}
+void RSPDuoHandle::reopen() {
+	std::lock_guard<std::mutex> lock {mutex};
 
-void Airspy::set_frequency(unsigned int frequency) {
-	AIRSPY_OPERATION(airspy_set_freq, device, frequency);
-}
+	// The frequencies and gains, as selecting resets them.  They are kept
+	// from the last time the RSPduo was selected if it is retried.
+	if (selected && params->rxChannelA != nullptr) {
+		channels[0] = *params->rxChannelA;
+	}
+
+	if (selected && params->rxChannelB != nullptr) {
+		channels[1] = *params->rxChannelB;
+	}
 
-void Airspy::set_sample_rate(unsigned int sample_rate) {
-	AIRSPY_OPERATION(airspy_set_samplerate, device, sample_rate);
+	close_device();
+	device = {};
+	params = nullptr;
+	open_device();
+
+	if (params->rxChannelA != nullptr) {
+		*params->rxChannelA = channels[0];
+	}
+
+	if (params->rxChannelB != nullptr) {
+		*params->rxChannelB = channels[1];
+	}
+
+	if (streams[0].process.load() != nullptr ||
+	    streams[1].process.load() != nullptr) {
+		init();
+	}
 }
 
-void Airspy::set_sample_type(airspy_sample_type sample_type) {
-	AIRSPY_OPERATION(airspy_set_sample_type, device, sample_type);
+/**
+ * Starts streaming.  The mutex must be held.
+ */
+void RSPDuoHandle::init() {
+	sdrplay_api_CallbackFnsT callbacks {stream_a, stream_b, event};
+
+	RSPDUO_OPERATION(sdrplay_api_Init, device.dev, &callbacks,
+			 static_cast<void *> (this));
+	initialised = true;
+	streaming = true;
 }
 
-void Airspy::set_gain(int gain) {
-	AIRSPY_OPERATION(airspy_set_linearity_gain, device, gain);
+void RSPDuoHandle::start(sdrplay_api_TunerSelectT tuner,
+			 Process<int16_t> &process) {
+	std::lock_guard<std::mutex> lock {mutex};
+	RSPDuoStream &stream {this->stream(tuner)};
+
+	// Not used by the callback until the process is set.
+	stream.buffer = process.input_buffer();
+	stream.filled = 0;
+	stream.dropped = 0;
+	stream.process.store(&process);
+
+	if (!initialised) {
+		try {
+			init();
+		} catch (...) {
+			stream.process.store(nullptr);
+			throw;
+		}
+	}
 }
 
-Airspy::~Airspy() {
-	if (device != nullptr) {
-		airspy_close(device);
-		std::cout << "Closing airspy" << std::endl;
+void RSPDuoHandle::stop(sdrplay_api_TunerSelectT tuner) {
+	std::lock_guard<std::mutex> lock {mutex};
+
+	stream(tuner).process.store(nullptr);
+
+	// Both sequentially consistent, so that the callback either sees no
+	// process, or is seen busy with it.
+	while (stream(tuner).busy.load()) {
+		std::this_thread::yield();
+	}
+
+	if (initialised && streams[0].process.load() == nullptr &&
+	    streams[1].process.load() == nullptr) {
+		sdrplay_api_Uninit(device.dev);
+		initialised = false;
+		streaming = false;
 	}
 }
 
+void RSPDuoHandle::release(sdrplay_api_TunerSelectT tuner) {
+	stop(tuner);
 
- * A callback to wrap the real process to apply.
- *
- * This functions checks if the Airspy is still synced with its clock, and calls
- * the process provided.
- *
- * To check if the Airspy is still synced, the register 0 is dumped.  If the 4th
- * bit is set, the device is still synced.  If not, the device is out of sync,
- * and a warning is printed to stderr.
+	std::lock_guard<std::mutex> lock {mutex};
+	stream(tuner).claimed = false;
+}
 
- * Then, it converts the context parameter to a Process, and calls its method
- * apply().  This call should be inlined when the program is optimised.
+/**
+ * Interleaves the I and Q samples of a callback into the input buffer of the
+ * process, and hands the buffer over each time it is full.  The amount of
+ * samples of a callback varies, so they may fill a buffer, and start the
+ * next one.
  *
- * This function delegates the processing instead of doing itself, because if we
- * wanted to handle another device kind, we would have to duplicate the process
- * in the other callback.  Moving the process makes it agnostic of the
- * underlying device and reusable.  Some parameters are needed (such as the
- * filter used), so it's a class and not a freestanding function.
+ * When reset is set, the samples do not follow the previous ones, so the
+ * partial buffer is discarded, and counted as dropped.
  *
- * @param transfer The data received from the Airspy.
+ * @param stream The stream of the tuner.
+ * @param xi The I samples.
+ * @param xq The Q samples.
+ * @param count The amount of IQ samples.
+ * @param reset Whether the stream was reset.
+ */
+void RSPDuoHandle::deliver(RSPDuoStream &stream, short const *xi,
+			   short const *xq, unsigned int count, bool reset) {
+	stream.busy.store(true);
+
+	Process<int16_t> *process {stream.process.load()};
+
+	if (process == nullptr) {
+		stream.busy.store(false, std::memory_order_release);
+		return;
+	}
+
+	if (reset) {
+		stream.dropped += stream.filled;
+		stream.filled = 0;
+	}
+
+	while (count > 0) {
+		const size_t n {std::min<size_t> (
+				count, rspduo_buffer_size - stream.filled)};
+		int16_t *out {stream.buffer + stream.filled * 2};
+
+		#pragma omp simd
+		for (size_t i = 0; i < n; i++) {
+			out[2 * i] = xi[i];
+			out[2 * i + 1] = xq[i];
+		}
+
+		xi += n;
+		xq += n;
+		count -= n;
+		stream.filled += n;
+
+		if (stream.filled == rspduo_buffer_size) {
+			process->apply_in_place(rspduo_buffer_size * 2,
+						stream.dropped);
+			stream.buffer = process->input_buffer();
+			stream.filled = 0;
+			stream.dropped = 0;
+		}
+	}
+
+	stream.busy.store(false, std::memory_order_release);
+}
+
+/**
+ * The callbacks of the streams of the tuners.  In single tuner mode, the
+ * samples of tuner B are delivered to the callback of the stream A too.
  */
-/*
-static int airspy_callback(airspy_transfer_t *transfer) {
-	// Dump register and check if the airspy is still synced.
-	uint8_t value;
-	auto result {static_cast<airspy_error> (
-			airspy_si5351c_read(transfer->device, 0, &value))};
+void RSPDuoHandle::stream_a(short *xi, short *xq,
+			    sdrplay_api_StreamCbParamsT *,
+			    unsigned int count, unsigned int reset,
+			    void *context) {
+	auto *handle {static_cast<RSPDuoHandle *> (context)};
+
+	deliver(handle->streams[handle->device.tuner == sdrplay_api_Tuner_B],
+		xi, xq, count, reset != 0);
+}
+
+void RSPDuoHandle::stream_b(short *xi, short *xq,
+			    sdrplay_api_StreamCbParamsT *,
+			    unsigned int count, unsigned int reset,
+			    void *context) {
+	auto *handle {static_cast<RSPDuoHandle *> (context)};
+
+	deliver(handle->streams[1], xi, xq, count, reset != 0);
+}
 
-	if (result != AIRSPY_SUCCESS) {
-		std::cerr << "Error: could not dump register." << std::endl;
-		std::cerr << airspy_error_name(result)
-			  << std::endl;
-	} else if (value & 0x10) {
-		std::cerr << "Warning: Airspy out of sync." << std::endl;
+/**
+ * The callback of the events of the RSPduo.  Power overloads must be
+ * acknowledged for the next ones to be reported.  The mutex is not taken, as
+ * stop() holds it while the API waits for its thread.
+ */
+void RSPDuoHandle::event(sdrplay_api_EventT id,
+			 sdrplay_api_TunerSelectT tuner,
+			 sdrplay_api_EventParamsT *params, void *context) {
+	auto *handle {static_cast<RSPDuoHandle *> (context)};
+	const char name {tuner == sdrplay_api_Tuner_B ? 'B' : 'A'};
+
+	switch (id) {
+	case sdrplay_api_PowerOverloadChange:
+		sdrplay_api_Update(handle->device.dev, tuner,
+				   sdrplay_api_Update_Ctrl_OverloadMsgAck,
+				   sdrplay_api_Update_Ext1_None);
+
+		if (params->powerOverloadParams.powerOverloadChangeType ==
+		    sdrplay_api_Overload_Detected) {
+			log_limited(handle->overloads, LogLevel::warning,
+				    "RSPduo: tuner %c overloaded", name);
+		}
+
+		break;
+	case sdrplay_api_DeviceRemoved:
+	case sdrplay_api_DeviceFailure:
+		handle->streaming = false;
+		log_message(LogLevel::error, "RSPduo %s: %s",
+			    handle->device.SerNo,
+			    id == sdrplay_api_DeviceRemoved ? "removed" :
+			    "failed");
+		break;
+	default:
+		break;
 	}
+}
 
-	if (transfer->dropped_samples > 0) {
-		std::cerr << "Dropped samples" << std::endl;
+RSPDuo::RSPDuo(std::string const &serial, sdrplay_api_TunerSelectT tuner,
+	       bool dual, unsigned int frequency, unsigned int sample_rate,
+	       int gain_reduction, int lna_state):
+	handle {RSPDuoHandle::open(serial, dual, tuner, sample_rate)},
+	tuner {tuner} {
+	try {
+		handle->channel(tuner).tunerParams.gain.LNAstate =
+			static_cast<unsigned char> (lna_state);
+		set_frequency(frequency);
+		set_gain(gain_reduction);
+	} catch (...) {
+		handle->release(tuner);
+		throw;
 	}
+}
+
+RSPDuo::~RSPDuo() {
+	handle->release(tuner);
+}
 
-	// Processing input buffer
-	// Get back the process and the samples.
-	auto *process {static_cast<Process<int16_t> *> (transfer->ctx)};
-	auto *samples {static_cast<int16_t *> (transfer->samples)};
+void RSPDuo::set_gain(int gain) {
+	handle->channel(tuner).tunerParams.gain.gRdB = gain;
+	handle->update(tuner, sdrplay_api_Update_Tuner_Gr);
+}
+
+void RSPDuo::set_frequency(unsigned int frequency) {
+	handle->channel(tuner).tunerParams.rfFreq.rfHz = frequency;
+	handle->update(tuner, sdrplay_api_Update_Tuner_Frf);
+}
 
-	process->apply(samples, transfer->sample_count * 2);
+bool RSPDuo::reopen() {
+	handle->reopen();
 
-	return 0;
+	return true;
 }
 
-void Airspy::receive(Process<int16_t> &process) {
-	AIRSPY_OPERATION(airspy_start_rx, device, airspy_callback,
-			 static_cast<void *> (&process));
+bool RSPDuo::is_streaming() {
+	return handle->is_streaming(tuner);
 }
 
-void Airspy::stop() {
-	airspy_stop_rx(device);
+void RSPDuo::receive(Process<int16_t> &process) {
+	handle->start(tuner, process);
 }
 
-size_t Airspy::buffer_size() {
-	// 262144 is from libairspy.  This is the size of the buffer in bytes.
-	// Divided by 2 for both IQ channels, then by the size of an int16_t
-	// (should be 2).  The final result should be equal to 65536.
-	return 262144 / 2 / sizeof(int16_t);
+void RSPDuo::stop() {
+	handle->stop(tuner);
 }
 
-int Airspy::max_value() {
-	// 2^12
-	return 4069;
-}*/
+size_t RSPDuo::buffer_size() {
+	return rspduo_buffer_size;
+}
+
+int RSPDuo::max_value() {
+	return 32767;
+}
@@ -1,18 +1,31 @@
-#ifndef DEVICE_RSPDUO_HPP
-#define DEVICE_RSPDUO_HPP
+#ifndef __ILSIMU_RASSEIVER_DEVICE_RSPDUO_HPP
+# define __ILSIMU_RASSEIVER_DEVICE_RSPDUO_HPP
 
-#include "sdrplay_api.h"
+# include "device.hpp"
 
-#include "device.hpp"
+# include <memory>
+# include <string>
 
+# include <sdrplay_api.h>
+
+class RSPDuoHandle;
 
 /**
- * A class to encapsulate an RSPDuo device.  It uses the sdrplay
- * api.
+ * A class to encapsulate a tuner of an RSPduo.  It uses the SDRplay API 3.
+ *
+ * This is an RAII class; when allocated on the stack or with an unique_ptr,
+ * the tuner stops streaming, and the RSPduo is released once none of its
+ * tuners is used anymore.
  *
- * This class offers some advantages.  Mainly, this is an RAII class; when
- * allocated on the stack or with an unique_ptr, the device will
- * be automatically closed.
+ * In single tuner mode, the tuner streams at the sample rate given, with a
+ * zero IF.  In dual tuner mode, both tuners stream at 2 MSPS, the only rate
+ * of this mode, and are used by two instances of this class, usually in two
+ * pipelines, which share the RSPduo and the thread of the API.
+ *
+ * The API delivers the I and Q samples in separate arrays, of a varying
+ * length.  They are interleaved straight into the input buffer of the
+ * process, which is handed over once full, so that the samples are not
+ * copied again.
  */
 class RSPDuo: public Device<int16_t> {
 public:
@@ -20,56 +33,55 @@ public:
 	RSPDuo() = delete;
 
 	/**
-	 * Opens an Airspy device with a specified frequency, sample rate,
-	 * and sample type.
+	 * Opens a tuner of an RSPduo.
 	 *
-	 * @param frequency The frequency of the signal to sample.
-	 * @param sample_rate Amount of samples the RSPDuo should take in a second.
+	 * @param serial The serial number of the RSPduo, or an empty string
+	 *   for the first one available.
+	 * @param tuner The tuner: sdrplay_api_Tuner_A or sdrplay_api_Tuner_B.
+	 * @param dual Whether the RSPduo is in dual tuner mode, so that the
+	 *   other tuner may be opened too.
+	 * @param frequency The frequency of the signal to sample, in Hz.
+	 * @param sample_rate Amount of samples the tuner should take in a
+	 *   second; 2000000 in dual tuner mode.
+	 * @param gain_reduction The gain reduction, in dB.
+	 * @param lna_state The state of the LNA, 0 for the highest gain.
 	 */
-	RSPDuo(unsigned int frequency=111100000,
-	       unsigned int sample_rate=2500000);
+	RSPDuo(std::string const &serial, sdrplay_api_TunerSelectT tuner,
+	       bool dual, unsigned int frequency, unsigned int sample_rate,
+	       int gain_reduction, int lna_state);
 
 	/**
-	 * Opens an Airspy device with a specific serial number, a specified
-	 * frequency, sample rate, and sample type.
-	 *
-	 * @param serial_num The serial number of the Airspy to open.
-	 * @param frequency The frequency of the signal to sample.
-	 * @param sample_rate Amount of samples the Airspy should take in a second.
-	 * @param sample_type Type of samples the Airspy should take.
+	 * Stops streaming, and releases the RSPduo if the other tuner is not
+	 * used.
 	 */
+	~RSPDuo() override;
 
 	/**
-	 * Closes the RSPDuo.
+	 * Sets the gain reduction.
+	 *
+	 * @param gain The gain reduction, in dB.
 	 */
-	~RSPDuo() override;
-
-
 	void set_gain(int gain) override;
-	bool is_streaming();
+	void set_frequency(unsigned int frequency) override;
+	bool is_streaming() override;
 
 	void receive(Process<int16_t> &process) override;
 	void stop() override;
 
+	/**
+	 * Releases the RSPduo, and selects it again by its serial number,
+	 * with the same frequencies and gains.  In dual tuner mode, the other
+	 * tuner keeps streaming into its process after a gap, so a stall of
+	 * one tuner recovers both.
+	 */
+	bool reopen() override;
+
 	size_t buffer_size() override;
 	int max_value() override;
 
 private:
-	void init_RSPDuo(unsigned int frequency, unsigned int sample_rate);
-	sdrplay_api_DeviceT devs[6];unsigned int ndev;
-	int i;
-	float ver= 0.0;
-	sdrplay_api_ErrT err;
-	sdrplay_api_DeviceParamsT *deviceParams = NULL;
-	sdrplay_api_CallbackFnsT cbFns;
-	sdrplay_api_RxChannelParamsT *chParams;
-
-	int reqTuner = 0;
-	int master_slave = 0;
-	unsigned int chosenIdx = 0;
-
-	sdrplay_api_DeviceT *device {nullptr};
-	sdrplay_api_DeviceT *chosenDevice = NULL;
+	const std::shared_ptr<RSPDuoHandle> handle;
+	const sdrplay_api_TunerSelectT tuner;
 };
 
-#endif // DEVICE_RSPDUO_HPP
+#endif  /* __ILSIMU_RASSEIVER_DEVICE_RSPDUO_HPP */
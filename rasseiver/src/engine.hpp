@@ -0,0 +1,675 @@
+#ifndef __ILSIMU_RASSEIVER_ENGINE_HPP
+# define __ILSIMU_RASSEIVER_ENGINE_HPP
+
+# include <algorithm>
+# include <array>
+# include <memory>
+# include <stdexcept>
+# include <string>
+# include <type_traits>
+# include <vector>
+
+# include <cmath>
+# include <cstdint>
+
+# include "circular_buffer.hpp"
+# include "filter.hpp"
+# include "sample_format.hpp"
+# include "worker_pool.hpp"
+
+/**
+ * An abstract filtering engine: a FIR and a decimation factor, applied to the
+ * buffers of a process.
+ *
+ * The engine is stateless (except for the phase of a ResamplerEngine); the
+ * position of the next output is kept by the process, so engines can be
+ * replaced between two buffers.
+ */
+template<typename T>
+class FilterEngine {
+public:
+	virtual ~FilterEngine() = default;
+
+	FilterEngine(FilterEngine const &) = delete;
+	FilterEngine &operator=(FilterEngine const &) = delete;
+
+	/**
+	 * Filters and decimates the current buffer.  See filter_buffer() for
+	 * the meaning of the parameters.
+	 *
+	 * @param buffer The buffer to filter.
+	 * @param output Where the output is written.
+	 * @param pos The index of the first element to filter.
+	 */
+	void apply(CircularBuffer<T> const &buffer, SampleWriter &output,
+		   size_t &pos) const {
+		apply(buffer, output, pos, buffer.size());
+	}
+
+	/**
+	 * Filters and decimates the current buffer, until an index.  This is
+	 * apply(), for the outputs of a part of the buffer only, so that they
+	 * can be sent before the rest is filtered.
+	 *
+	 * @param buffer The buffer to filter.
+	 * @param output Where the output is written.
+	 * @param pos The index of the first element to filter.
+	 * @param end The index at which filtering stops.
+	 */
+	virtual void apply(CircularBuffer<T> const &buffer, SampleWriter &output,
+			   size_t &pos, size_t end) const {
+		filter(buffer, output, pos, end);
+	}
+
+	/**
+	 * Filters and decimates a range of the current buffer.  See
+	 * filter_buffer() for the meaning of the parameters.
+	 *
+	 * @param buffer The buffer to filter.
+	 * @param output Where the output is written.
+	 * @param begin The index of the first element to filter.
+	 * @param end The index at which filtering stops.
+	 */
+	virtual void filter(CircularBuffer<T> const &buffer,
+			    SampleWriter &output, size_t &begin,
+			    size_t end) const = 0;
+
+	/**
+	 * Skips the outputs of the current buffer, as if they had been
+	 * computed by apply(), for instance when there is no room for them.
+	 *
+	 * @param buffer The buffer whose outputs are skipped.
+	 * @param pos The index of the first element to filter.
+	 */
+	virtual void skip(CircularBuffer<T> const &buffer, size_t &pos) const {
+		const size_t stride {(size_t) decimation * 2};
+
+		if (pos < buffer.size()) {
+			pos += (buffer.size() - pos + stride - 1) / stride *
+				stride;
+		}
+	}
+
+	/**
+	 * Returns the name of the engine.
+	 */
+	virtual char const *name() const = 0;
+
+	/**
+	 * Returns the amount of coefficients of the filter.
+	 */
+	virtual size_t length() const = 0;
+
+	/**
+	 * Returns the decimation factor.
+	 */
+	int step() const {
+		return decimation;
+	}
+
+protected:
+	/**
+	 * @param step The decimation factor.
+	 */
+	FilterEngine(int step): decimation {step} {
+	}
+
+private:
+	const int decimation;
+};
+
+/**
+ * The direct form engine: each output is the dot product of the filter and the
+ * input, computed with filter_buffer().
+ *
+ * C is the type of the coefficients and of the accumulators.
+ */
+template<typename T, typename C>
+class DirectEngine: public FilterEngine<T> {
+public:
+	/**
+	 * @param filter The filter, in double precision.  It is reversed and
+	 *   converted to C.
+	 * @param step The decimation factor.
+	 */
+	DirectEngine(Filter const &filter, int step):
+		FilterEngine<T> {step}, taps (filter.rbegin(), filter.rend()) {
+	}
+
+	void filter(CircularBuffer<T> const &buffer, SampleWriter &output,
+		    size_t &begin, size_t end) const override {
+		filter_buffer(buffer, taps, output, begin, end, this->step());
+	}
+
+	char const *name() const override {
+		return sizeof(C) == sizeof(float) ? "float" : "double";
+	}
+
+	size_t length() const override {
+		return taps.size();
+	}
+
+private:
+	const BasicFilter<C> taps;
+};
+
+/**
+ * A direct form engine specialised for a filter of N coefficients and a
+ * decimation factor of S.
+ *
+ * Except for the first outputs of a buffer, which also need the previous
+ * buffer and are computed by filter_buffer(), each output is the dot product
+ * of N contiguous samples and of the filter.  As N is known at compile time,
+ * this loop has no remainder to compute at run time, and the compiler can
+ * unroll it and schedule its loads freely.
+ */
+template<typename T, typename C, size_t N, int S>
+class FixedEngine: public FilterEngine<T> {
+public:
+	/**
+	 * @param filter The filter, in double precision.  It must have N
+	 *   coefficients.
+	 */
+	FixedEngine(Filter const &filter):
+		FilterEngine<T> {S}, taps (filter.rbegin(), filter.rend()) {
+		std::copy(taps.begin(), taps.end(), fixed_taps.begin());
+	}
+
+	void filter(CircularBuffer<T> const &buffer, SampleWriter &output,
+		    size_t &begin, size_t end) const override {
+		// The index of the first output computed from the current
+		// buffer only.
+		constexpr size_t edge {(N - 1) * 2};
+		size_t &i {begin};
+
+		if (i < edge) {
+			filter_buffer(buffer, taps, output, i,
+				      std::min(end, edge), S);
+		}
+
+		C const *h {fixed_taps.data()};
+
+		for (; i < end; i += S * 2) {
+			C valueI {}, valueQ {};
+			T const *x {buffer.get_current().data() + i - edge};
+
+#pragma omp simd reduction(+: valueI, valueQ)
+			for (size_t j = 0; j < N; j++) {
+				valueI += x[j * 2] * h[j];
+				valueQ += x[j * 2 + 1] * h[j];
+			}
+
+			output.put(valueI, valueQ);
+		}
+	}
+
+	char const *name() const override {
+		return sizeof(C) == sizeof(float) ? "fixed float" :
+			"fixed double";
+	}
+
+	size_t length() const override {
+		return N;
+	}
+
+private:
+	// filter_buffer() takes a BasicFilter for the first outputs.
+	const BasicFilter<C> taps;
+	std::array<C, N> fixed_taps;
+};
+
+/**
+ * A (filter length, decimation factor) pair for which a FixedEngine is
+ * compiled.
+ */
+template<size_t N, int S>
+struct FixedKernel {
+};
+
+/**
+ * The list of kernels compiled in.  Each one costs some code size, so only
+ * the pairs used in deployments are listed here.
+ */
+template<typename... Kernels>
+struct FixedKernelList {
+};
+
+using FixedKernels = FixedKernelList<
+	FixedKernel<801, 60>, // LPDFilter.fcf, 2.5 MSPS
+	FixedKernel<801, 240> // LPDFilter.fcf, 10 MSPS
+	>;
+
+/**
+ * Looks for a kernel matching a filter in a list.  This is the end of the
+ * list: no kernel matched.
+ */
+template<typename T, typename C>
+std::unique_ptr<FilterEngine<T>> make_fixed_engine(FixedKernelList<>,
+						   Filter const &, int) {
+	return nullptr;
+}
+
+/**
+ * Looks for a kernel matching a filter in a list.
+ *
+ * @param filter The filter.
+ * @param step The decimation factor.
+ * @returns A FixedEngine, or nullptr if no kernel of the list matches.
+ */
+template<typename T, typename C, size_t N, int S, typename... Kernels>
+std::unique_ptr<FilterEngine<T>> make_fixed_engine(
+	FixedKernelList<FixedKernel<N, S>, Kernels...>, Filter const &filter,
+	int step) {
+	if (filter.size() == N && step == S) {
+		return std::make_unique<FixedEngine<T, C, N, S>> (filter);
+	}
+
+	return make_fixed_engine<T, C> (FixedKernelList<Kernels...> {},
+					filter, step);
+}
+
+/**
+ * A direct form engine with fixed-point coefficients, for integer samples.
+ *
+ * The coefficients are scaled and rounded to 16 bits integers, and the
+ * products are accumulated in 32 bits integers, so the vectorised loops
+ * handle twice as many values per instruction as with single precision.  The
+ * scale is the largest one for which neither the coefficients nor the
+ * accumulators can overflow, as long as the samples do not exceed the max
+ * value of the device.
+ *
+ * The outputs differ slightly from those of a floating point engine; the
+ * error is well below the resolution of a 12 bits ADC with usual filters.
+ */
+template<typename T>
+class QuantizedEngine: public FilterEngine<T> {
+public:
+	/**
+	 * @param filter The filter, in double precision.
+	 * @param step The decimation factor.
+	 * @param max_value The max absolute value of the samples.
+	 */
+	QuantizedEngine(Filter const &filter, int step, int max_value):
+		FilterEngine<T> {step}, scale {quantization_scale(filter,
+								   max_value)},
+		taps (quantize(filter, scale)) {
+	}
+
+	void filter(CircularBuffer<T> const &buffer, SampleWriter &output,
+		    size_t &begin, size_t end) const override {
+		filter_buffer<T, int16_t, int32_t> (buffer, taps, output, begin,
+						    end, this->step(),
+						    1 / scale);
+	}
+
+	char const *name() const override {
+		return "q15";
+	}
+
+	size_t length() const override {
+		return taps.size();
+	}
+
+private:
+	static double quantization_scale(Filter const &filter, int max_value) {
+		double max {0}, sum {0};
+
+		for (double h: filter) {
+			max = std::max(max, std::abs(h));
+			sum += std::abs(h);
+		}
+
+		if (max == 0) {
+			return 1;
+		}
+
+		return std::min(INT16_MAX / max,
+				INT32_MAX / (sum * std::max(max_value, 1)));
+	}
+
+	static BasicFilter<int16_t> quantize(Filter const &filter,
+					     double scale) {
+		BasicFilter<int16_t> taps;
+
+		for (auto h = filter.rbegin(); h != filter.rend(); h++) {
+			taps.push_back(static_cast<int16_t> (
+					       std::lround(*h * scale)));
+		}
+
+		return taps;
+	}
+
+	const double scale;
+	const BasicFilter<int16_t> taps;
+};
+
+/**
+ * A polyphase resampler, for output rates which are not an integer fraction
+ * of the sample rate.  The rate is multiplied by L/M, the ratio of the output
+ * rate to the sample rate.
+ *
+ * The filter is designed for the sample rate, as for a DirectEngine, and
+ * seen as a continuous impulse response: the output at the (fractional)
+ * input time i + p/L uses the coefficients h(k + p/L), interpolated linearly
+ * between those of the filter.  These L sets of coefficients are computed
+ * once, so each output costs a single dot product of the filter length, like
+ * an output of a DirectEngine, and is computed with filter_buffer().
+ *
+ * The phase p of the next output is carried from a buffer to the next, so
+ * unlike other engines, this one is not stateless, and is not shared between
+ * threads.
+ */
+template<typename T, typename C>
+class ResamplerEngine: public FilterEngine<T> {
+public:
+	/**
+	 * @param filter The filter, in double precision, designed for the
+	 *   sample rate.
+	 * @param up The interpolation factor L.
+	 * @param down The decimation factor M, higher or equal to L.
+	 */
+	ResamplerEngine(Filter const &filter, int up, int down):
+		FilterEngine<T> {down / up}, up {up}, down {down},
+		banks (up) {
+		const int count {(int) filter.size()};
+
+		// h(p / L - 1), before the first coefficient, is left out, so
+		// that all phases have the length of the filter.  The
+		// coefficients at both ends of a long filter are tiny anyway.
+		for (int p = 0; p < up; p++) {
+			for (int k = count - 1; k >= 0; k--) {
+				// Reversed, as for filter_buffer().
+				const double next {k + 1 < count ?
+						   filter[k + 1] : 0};
+
+				banks[p].push_back(static_cast<C> (
+					filter[k] + (next - filter[k]) * p / up));
+			}
+		}
+	}
+
+	void filter(CircularBuffer<T> const &buffer, SampleWriter &output,
+		    size_t &begin, size_t end) const override {
+		size_t &i {begin};
+
+		for (; i < end; advance(i)) {
+			size_t j {i};
+
+			filter_buffer(buffer, banks[phase], output, j, j + 1, 1);
+		}
+	}
+
+	void skip(CircularBuffer<T> const &buffer,
+		  size_t &pos) const override {
+		while (pos < buffer.size()) {
+			advance(pos);
+		}
+	}
+
+	char const *name() const override {
+		return sizeof(C) == sizeof(float) ? "resampler float" :
+			"resampler double";
+	}
+
+	size_t length() const override {
+		return banks.front().size();
+	}
+
+private:
+	/**
+	 * Moves to the input time of the next output.
+	 */
+	void advance(size_t &i) const {
+		phase += down;
+		i += phase / up * 2;
+		phase %= up;
+	}
+
+	const int up, down;
+	std::vector<BasicFilter<C>> banks;
+
+	// The next output is at the input time i + phase / up.
+	mutable int phase {0};
+};
+
+/**
+ * Runs another engine on several threads.
+ *
+ * The outputs of a buffer are independent, so they are split in slices of
+ * consecutive outputs, which are computed by the threads of a WorkerPool and
+ * written to disjoint parts of the output buffer.  The pool may be shared by
+ * the engines of several devices.  Each output is computed
+ * exactly as by the wrapped engine, so the result is bit-identical.
+ */
+template<typename T>
+class ParallelEngine: public FilterEngine<T> {
+public:
+	/**
+	 * Attaches the engine to a pool.
+	 *
+	 * @param engine The engine computing the outputs.
+	 * @param pool The threads sharing the work with the caller of
+	 *   apply().  It must outlive the engine.
+	 */
+	ParallelEngine(std::unique_ptr<FilterEngine<T>> engine,
+		       WorkerPool &pool):
+		FilterEngine<T> {engine->step()}, engine {std::move(engine)},
+		pool {pool}, slot {pool.attach()} {
+	}
+
+	~ParallelEngine() {
+		pool.detach(slot);
+	}
+
+	using FilterEngine<T>::apply;
+
+	void apply(CircularBuffer<T> const &buffer, SampleWriter &output,
+		   size_t &pos, size_t end) const override {
+		const size_t stride {(size_t) this->step() * 2};
+
+		if (pos >= end) {
+			return;
+		}
+
+		Job job {*this, buffer, output, pos, end,
+			 (end - pos + stride - 1) / stride, 0};
+
+		// A few slices per thread, so that a preempted thread does not
+		// delay the whole buffer, but not so small that handing them
+		// out costs more than computing them: the minimum is set by the
+		// amount of multiply-adds, ie. taps times outputs.
+		const size_t slice {job.count /
+				    ((pool.size() + 1) * slices_per_thread) + 1};
+		const size_t minimum {min_slice_cost / (engine->length() + 1) +
+				      1};
+		job.slice = slice > minimum ? slice : minimum;
+
+		output.flush();
+		pool.run(slot, &ParallelEngine::run_slice, &job,
+			 (job.count + job.slice - 1) / job.slice);
+		output.skip(job.count);
+
+		pos += job.count * stride;
+	}
+
+	void filter(CircularBuffer<T> const &buffer, SampleWriter &output,
+		    size_t &begin, size_t end) const override {
+		engine->filter(buffer, output, begin, end);
+	}
+
+	char const *name() const override {
+		return engine->name();
+	}
+
+	size_t length() const override {
+		return engine->length();
+	}
+
+private:
+	// About 10 µs of filtering, far more than taking a task.
+	static constexpr size_t min_slice_cost {16384};
+	static constexpr size_t slices_per_thread {4};
+
+	/**
+	 * The filtering of a buffer, shared by the threads.
+	 */
+	struct Job {
+		ParallelEngine const &engine;
+		CircularBuffer<T> const &buffer;
+		SampleWriter const &output;
+		const size_t pos;
+		const size_t end;
+		const size_t count; // Amount of outputs
+		size_t slice;       // Amount of outputs per slice
+	};
+
+	static void run_slice(void *context, size_t index) {
+		Job const &job {*static_cast<Job const *> (context)};
+		const size_t stride {(size_t) job.engine.step() * 2};
+		const size_t first {index * job.slice};
+		const size_t last {std::min(first + job.slice, job.count)};
+		size_t begin {job.pos + first * stride};
+
+		SampleWriter writer {job.output, first};
+
+		job.engine.filter(job.buffer, writer, begin,
+				  std::min(job.pos + last * stride,
+					   job.end));
+		writer.flush();
+	}
+
+	const std::unique_ptr<FilterEngine<T>> engine;
+	WorkerPool &pool;
+	const size_t slot;
+};
+
+/**
+ * Adds the direct form engines of a precision to a list: the FixedEngine
+ * compiled for the length of the filter and the decimation factor, if any, and
+ * the DirectEngine.
+ *
+ * @param engines The list.
+ * @param filter The filter.
+ * @param step The decimation factor.
+ */
+template<typename T, typename C>
+void add_direct_engines(std::vector<std::unique_ptr<FilterEngine<T>>> &engines,
+			Filter const &filter, int step) {
+	auto engine = make_fixed_engine<T, C> (FixedKernels {}, filter, step);
+
+	if (engine != nullptr) {
+		engines.push_back(std::move(engine));
+	}
+
+	engines.push_back(std::make_unique<DirectEngine<T, C>> (filter, step));
+}
+
+/**
+ * Adds a QuantizedEngine to a list, if the samples are integers.
+ */
+template<typename T>
+void add_quantized_engine(std::vector<std::unique_ptr<FilterEngine<T>>> &engines,
+			  Filter const &filter, int step, int max_value,
+			  std::true_type) {
+	engines.push_back(std::make_unique<QuantizedEngine<T>> (
+				  filter, step, max_value));
+}
+
+template<typename T>
+void add_quantized_engine(std::vector<std::unique_ptr<FilterEngine<T>>> &,
+			  Filter const &, int, int, std::false_type) {
+}
+
+/**
+ * Creates all the filtering engines able to filter a buffer with a given
+ * precision, to be chosen from by autotune().  If the precision is unknown,
+ * a std::runtime_error is thrown.
+ *
+ * @param precision The precision of the coefficients and accumulators:
+ *   "double", "float", "q15" (16 bits fixed-point coefficients, integer
+ *   samples only), or "auto" for all of them.  Samples of 12 bits ADCs do
+ *   not need more than single precision.
+ * @param filter The filter.
+ * @param step The decimation factor.
+ * @param max_value The max absolute value of the samples.
+ */
+template<typename T>
+std::vector<std::unique_ptr<FilterEngine<T>>> make_engines(
+	std::string const &precision, Filter const &filter, int step,
+	int max_value) {
+	std::vector<std::unique_ptr<FilterEngine<T>>> engines;
+	const bool any {precision == "auto"};
+
+	if (any || precision == "double") {
+		add_direct_engines<T, double> (engines, filter, step);
+	}
+
+	if (any || precision == "float") {
+		add_direct_engines<T, float> (engines, filter, step);
+	}
+
+	if (any || precision == "q15") {
+		add_quantized_engine<T> (engines, filter, step, max_value,
+					 std::is_integral<T> {});
+	}
+
+	if (engines.empty()) {
+		throw std::runtime_error {"Unknown precision \"" + precision +
+				"\""};
+	}
+
+	return engines;
+}
+
+/**
+ * Creates a ResamplerEngine converting a sample rate to an output rate.  If
+ * the output rate is higher than the sample rate, if their ratio needs too
+ * many phases, or if the precision is not available, a std::runtime_error is
+ * thrown.
+ *
+ * @param precision "double", "float", or "auto" (single precision).
+ * @param filter The filter, designed for the sample rate.
+ * @param sample_rate The sample rate of the device, in Hz.
+ * @param output_rate The output rate, in Hz.
+ */
+template<typename T>
+std::unique_ptr<FilterEngine<T>> make_resampler(std::string const &precision,
+						Filter const &filter,
+						unsigned int sample_rate,
+						unsigned int output_rate) {
+	// Each phase holds a copy of the filter.
+	constexpr unsigned int max_phases {1024};
+	unsigned int a {sample_rate}, b {output_rate};
+
+	if (output_rate == 0 || output_rate > sample_rate) {
+		throw std::runtime_error {
+			"The output rate must be lower than the sample rate"};
+	}
+
+	while (b != 0) {
+		a %= b;
+		std::swap(a, b);
+	}
+
+	const unsigned int up {output_rate / a}, down {sample_rate / a};
+
+	if (up > max_phases) {
+		throw std::runtime_error {
+			"The ratio of the output rate to the sample rate is "
+			"too complex (" + std::to_string(up) + "/" +
+			std::to_string(down) + ")"};
+	}
+
+	if (precision == "double") {
+		return std::make_unique<ResamplerEngine<T, double>> (
+			filter, up, down);
+	} else if (precision == "float" || precision == "auto") {
+		return std::make_unique<ResamplerEngine<T, float>> (
+			filter, up, down);
+	}
+
+	throw std::runtime_error {"The " + precision + " precision is not "
+			"available with an output rate"};
+}
+
+#endif  /* __ILSIMU_RASSEIVER_ENGINE_HPP */
@@ -1,24 +1,176 @@
 #include <fstream>
 #include <iostream>
+#include <sstream>
 #include <vector>
 
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
 #include "filter.hpp"
 
-void filter_read_file(std::string const &file, Filter &filter) {
-	std::ifstream valueFile {file};
-	std::string line;
+/**
+ * The header of a filter cache, followed by `count' coefficients, as doubles.
+ * The file is in the byte order of the machine which wrote it, which is
+ * checked with `magic'.
+ */
+struct FilterCacheHeader {
+	uint64_t magic;
+	uint32_t version;
+	uint32_t reserved;
+	uint64_t source_hash; // FNV-1a of the content of the filter file
+	uint64_t count;
+};
 
-	if (!valueFile.fail()) {
-		while (std::getline(valueFile, line)) {
-			try {
-				double value = std::stod(line);
-				filter.push_back(value);
-			} catch (std::invalid_argument const &e) {
-				// Not a number, ignoring
+static constexpr uint64_t filter_cache_magic {0x4643462e53534152}; // RASS.FCF
+static constexpr uint32_t filter_cache_version {1};
+
+/**
+ * A read-only memory mapping of a whole file.
+ */
+class MappedFile {
+public:
+	MappedFile(std::string const &file) {
+		int fd {open(file.c_str(), O_RDONLY | O_CLOEXEC)};
+		struct stat st;
+
+		if (fd < 0) {
+			return;
+		}
+
+		if (fstat(fd, &st) == 0 && st.st_size > 0) {
+			void *mapping {mmap(nullptr, st.st_size, PROT_READ,
+					    MAP_PRIVATE, fd, 0)};
+
+			if (mapping != MAP_FAILED) {
+				data = static_cast<uint8_t const *> (mapping);
+				size = st.st_size;
 			}
 		}
-	} else {
+
+		close(fd);
+	}
+
+	~MappedFile() {
+		if (data != nullptr) {
+			munmap(const_cast<uint8_t *> (data), size);
+		}
+	}
+
+	MappedFile(MappedFile const &) = delete;
+	MappedFile &operator=(MappedFile const &) = delete;
+
+	uint8_t const *data {nullptr};
+	size_t size {0};
+};
+
+static uint64_t fnv1a(uint8_t const *data, size_t size) {
+	uint64_t hash {0xcbf29ce484222325};
+
+	for (size_t i = 0; i < size; i++) {
+		hash = (hash ^ data[i]) * 0x100000001b3;
+	}
+
+	return hash;
+}
+
+/**
+ * Parses the text of a filter file: every line which is a number is a
+ * coefficient.
+ */
+static void parse_filter(std::istream &input, Filter &filter) {
+	std::string line;
+
+	while (std::getline(input, line)) {
+		try {
+			double value = std::stod(line);
+			filter.push_back(value);
+		} catch (std::invalid_argument const &e) {
+			// Not a number, ignoring
+		}
+	}
+}
+
+/**
+ * Reads the coefficients from a cache, if it is valid.
+ *
+ * @returns true if the cache was valid.
+ */
+static bool read_cache(std::string const &cache, uint64_t hash,
+		       Filter &filter) {
+	MappedFile mapped {cache};
+	FilterCacheHeader header;
+
+	if (mapped.size < sizeof(header)) {
+		return false;
+	}
+
+	std::memcpy(&header, mapped.data, sizeof(header));
+
+	if (header.magic != filter_cache_magic ||
+	    header.version != filter_cache_version ||
+	    header.source_hash != hash ||
+	    mapped.size != sizeof(header) + header.count * sizeof(double)) {
+		return false;
+	}
+
+	const size_t offset {filter.size()};
+
+	filter.resize(offset + header.count);
+	std::memcpy(filter.data() + offset, mapped.data + sizeof(header),
+		    header.count * sizeof(double));
+
+	return true;
+}
+
+/**
+ * Writes a cache.  It is written to a temporary file, and renamed, so that a
+ * concurrent reader never sees a partial cache.
+ */
+static void write_cache(std::string const &cache, uint64_t hash,
+			double const *values, size_t count) {
+	const std::string tmp {cache + ".tmp" + std::to_string(getpid())};
+	FilterCacheHeader header {filter_cache_magic, filter_cache_version, 0,
+				  hash, count};
+	std::ofstream output {tmp, std::ios::binary | std::ios::trunc};
+
+	output.write(reinterpret_cast<char const *> (&header), sizeof(header));
+	output.write(reinterpret_cast<char const *> (values),
+		     count * sizeof(double));
+	output.close();
+
+	if (!output || std::rename(tmp.c_str(), cache.c_str())) {
+		std::remove(tmp.c_str());
+	}
+}
+
+void filter_read_file(std::string const &file, Filter &filter) {
+	MappedFile source {file};
+	const std::string cache {file + ".cache"};
+
+	if (source.data == nullptr) {
 		std::cerr << "Failed to open file \"" << file << "\""
 			  << std::endl;
+		return;
+	}
+
+	const uint64_t hash {fnv1a(source.data, source.size)};
+
+	if (read_cache(cache, hash, filter)) {
+		return;
 	}
+
+	const size_t offset {filter.size()};
+	std::istringstream input {std::string {
+			reinterpret_cast<char const *> (source.data),
+			source.size}};
+
+	parse_filter(input, filter);
+	write_cache(cache, hash, filter.data() + offset,
+		    filter.size() - offset);
 }
@@ -1,18 +1,30 @@
 #ifndef __ILSIMU_RASSEIVER_FILTER_HPP
 # define __ILSIMU_RASSEIVER_FILTER_HPP
 
+# include <algorithm>
 # include <string>
 # include <vector>
 
-# include <cmath>
-
 # include "circular_buffer.hpp"
+# include "sample_format.hpp"
+
+/**
+ * The coefficients of a FIR, with a configurable precision.
+ */
+template<typename C>
+using BasicFilter = std::vector<C>;
 
-using Filter = std::vector<double>;
+using Filter = BasicFilter<double>;
 
 /**
  * Read filter parameters from a file.  `values' is not cleared.
  *
+ * Parsing a long filter takes a while, so the coefficients are cached in a
+ * binary file next to the filter (`file' followed by ".cache"), which is
+ * memory-mapped by later reads.  The cache holds a hash of the content of the
+ * filter file, so it is rebuilt as soon as the filter changes.  If the cache
+ * cannot be written, the filter is parsed on each read.
+ *
  * @param file The file to read the configuration from.
  * @param values The vector where the read values are stored.
  */
@@ -25,64 +37,75 @@ void filter_read_file(std::string const &file, Filter &filter);
  * This function does not permorm any kind of bound checking when accessing to
  * values in the buffer.  Make sure it is big enough.
  *
- * Saturation occurs when the modulus of an IQ sample is higher or equal to the
- * threshold.  Although it is not the best way to calculate it, it's relatively
- * fast and simple.
+ * Saturation is not detected here, but on the raw input with meter_buffer().
+ *
+ * The coefficients are expected in reverse order, so that both the samples and
+ * the coefficients are read forward.  The two loops computing an output are
+ * reductions, so they are vectorised; by default the accumulators are of the
+ * same type as the coefficients, so a single precision filter processes twice
+ * as many values per instruction as a double precision one.
+ *
+ * With fixed-point coefficients (eg. int16_t), the accumulators (A) must be
+ * wide enough not to overflow, and `gain' brings the outputs back to the
+ * scale of the input.
  *
  * @param buffer The buffer to filter.
- * @param filter The values of the FIR.
- * @param output The output.
+ * @param taps The values of the FIR, in reverse order.
+ * @param output Where the output is written.  SampleWriter::flush() is not
+ *   called.
  * @param begin The index of the first element to filter.  It is used by the
  *   loop as an index and is incremented in `step * 2' increments.  When the
- *   function returns, its value will be between `buffer.size()' and
- *   `buffer.size() + step * 2'.
+ *   function returns, its value will be between `end' and `end + step * 2'.
+ * @param end The index at which filtering stops, at most `buffer.size()'.
+ *   Filtering a buffer in several ranges gives the same outputs as filtering
+ *   it at once.
  * @param step The decimation factor.  Only one value out of `step` is
  *   filtered.  The result is the same as if the filter was applied to the
  *   whole input, and then decimated, but it's faster to do both at the
  *   same time.
- * @return True if a saturation occurs, otherwise false.
+ * @param gain The factor by which each output is multiplied.
  */
-template<typename T>
-bool filter_buffer(CircularBuffer<T> const &buffer, Filter const &filter,
-		   std::vector<T> &output, size_t &begin, int step,
-		   int threshold) {
+template<typename T, typename C, typename A = C>
+void filter_buffer(CircularBuffer<T> const &buffer, BasicFilter<C> const &taps,
+		   SampleWriter &output, size_t &begin, size_t end, int step,
+		   double gain = 1) {
 	size_t &i {begin};
-	bool saturation {false};
-	//
-	std::vector<T> const &previous {buffer.get_previous()},
+	PageVector<T> const &previous {buffer.get_previous()},
 		&current {buffer.get_current()};
+	const int count {(int) taps.size()};
 
-	for (; i < buffer.size(); i += step * 2) {
-		double valueI {}, valueQ {};
-		//j filter index, k sample index.
-		int j {(int) filter.size() - 1}, k {(int) (i - (j * 2))};
+	for (; i < end; i += step * 2) {
+		A valueI {}, valueQ {};
+		C const *h {taps.data()};
+		// n amount of coefficients, k index of the oldest sample.
+		int n {count}, k {(int) i - (count - 1) * 2};
 
 		// if necessary, process the previous buffer
 		if (k < 0) {
-			k += previous.size();
+			T const *x {previous.data() + previous.size() + k};
+			int m {std::min(n, -k / 2)};
 
-			while (j >= 0 && k < (int) previous.size()) {
-				valueI += previous[k++] * filter[j];
-				valueQ += previous[k++] * filter[j--];
+#pragma omp simd reduction(+: valueI, valueQ)
+			for (int j = 0; j < m; j++) {
+				valueI += x[j * 2] * h[j];
+				valueQ += x[j * 2 + 1] * h[j];
 			}
 
+			h += m;
+			n -= m;
 			k = 0;
 		}
 
-		while (j >= 0) {
-			valueI += current[k++] * filter[j];
-			valueQ += current[k++] * filter[j--];
-		}
-
-		output.push_back(std::round(valueI));
-		output.push_back(std::round(valueQ));
+		T const *x {current.data() + k};
 
-		if (std::sqrt(valueI * valueI + valueQ * valueQ) >= threshold) {
-			saturation = true;
+#pragma omp simd reduction(+: valueI, valueQ)
+		for (int j = 0; j < n; j++) {
+			valueI += x[j * 2] * h[j];
+			valueQ += x[j * 2 + 1] * h[j];
 		}
-	}
 
-	return saturation;
+		output.put(valueI * gain, valueQ * gain);
+	}
 }
 
 #endif  /* __ILSIMU_RASSEIVER_FILTER_HPP */
@@ -0,0 +1,102 @@
+#include "ils_meter.hpp"
+
+#include <algorithm>
+#include <stdexcept>
+
+#include <cmath>
+
+constexpr double IlsMeter::tones[];
+
+IlsMeter::IlsMeter(double rate, double period):
+	rate {rate}, window {static_cast<size_t> (std::lround(rate * period))},
+	tables (tone_count * 2 * window) {
+	if (window == 0) {
+		throw std::runtime_error {"The ILS window is empty"};
+	}
+
+	for (size_t t = 0; t < tone_count; t++) {
+		const double omega {2 * M_PI * tones[t] / rate};
+
+		for (size_t n = 0; n < window; n++) {
+			tables[(t * 2) * window + n] = std::cos(omega * n);
+			tables[(t * 2 + 1) * window + n] = std::sin(omega * n);
+		}
+	}
+}
+
+void IlsMeter::accumulate(float const *input, size_t count) {
+	float const *table {tables.data() + position};
+	float sum {}, c0 {}, s0 {}, c1 {}, s1 {}, c2 {}, s2 {};
+
+#pragma omp simd reduction(+: sum, c0, s0, c1, s1, c2, s2)
+	for (size_t n = 0; n < count; n++) {
+		const float e {std::sqrt(input[n * 2] * input[n * 2] +
+					 input[n * 2 + 1] * input[n * 2 + 1])};
+
+		sum += e;
+		c0 += e * table[n];
+		s0 += e * table[window + n];
+		c1 += e * table[window * 2 + n];
+		s1 += e * table[window * 3 + n];
+		c2 += e * table[window * 4 + n];
+		s2 += e * table[window * 5 + n];
+	}
+
+	envelope += sum;
+	correlations[0] += c0;
+	correlations[1] += s0;
+	correlations[2] += c1;
+	correlations[3] += s1;
+	correlations[4] += c2;
+	correlations[5] += s2;
+	position += count;
+}
+
+IlsRecord IlsMeter::record(int64_t time) {
+	const double carrier {envelope / window};
+	double depths[tone_count];
+
+	for (size_t t = 0; t < tone_count; t++) {
+		// The amplitude of the tone, relative to the carrier.
+		const double amplitude {2 * std::hypot(correlations[t * 2],
+						       correlations[t * 2 + 1]) /
+					window};
+
+		depths[t] = carrier > 0 ? amplitude / carrier : 0;
+	}
+
+	position = 0;
+	envelope = 0;
+	std::fill(std::begin(correlations), std::end(correlations), 0);
+
+	return {
+		time,
+		static_cast<float> (carrier),
+		static_cast<float> (depths[0]),
+		static_cast<float> (depths[1]),
+		static_cast<float> (depths[0] - depths[1]),
+		static_cast<float> (depths[0] + depths[1]),
+		static_cast<float> (depths[2]),
+	};
+}
+
+size_t IlsMeter::measure(float const *input, size_t count, int64_t time,
+			 IlsRecord *records) {
+	size_t n {0};
+
+	for (size_t i = 0; i < count;) {
+		const size_t length {std::min(count - i, window - position)};
+
+		accumulate(input + i * 2, length);
+		i += length;
+
+		if (position == window) {
+			// The window ended `count - i' samples before the last
+			// one.
+			records[n++] = record(time - static_cast<int64_t> (
+						      (count - i) * 1e9 / rate));
+		}
+	}
+
+	return n;
+}
@@ -0,0 +1,120 @@
+#ifndef __ILSIMU_RASSEIVER_ILS_METER_HPP
+# define __ILSIMU_RASSEIVER_ILS_METER_HPP
+
+# include <vector>
+
+# include <cstddef>
+# include <cstdint>
+
+/**
+ * The measurements of an ILS signal over a window, sent instead of the samples
+ * with the ils output format.
+ *
+ * The layout of this structure is also its layout on the network, so it must
+ * not contain any padding.
+ */
+struct IlsRecord {
+	/**
+	 * The time of the last sample of the window, in nanoseconds since the
+	 * Unix epoch.
+	 */
+	int64_t time;
+
+	/**
+	 * The mean amplitude of the carrier, in output units.
+	 */
+	float carrier;
+
+	/**
+	 * The modulation depths of the 90 Hz and 150 Hz tones, and of the
+	 * 1020 Hz ident tone, between 0 and 1.
+	 */
+	float depth_90;
+	float depth_150;
+
+	/**
+	 * The difference and the sum of the depths of the 90 Hz and 150 Hz
+	 * tones.
+	 */
+	float ddm;
+	float sdm;
+
+	float depth_1020;
+};
+
+static_assert(sizeof(IlsRecord) == 32, "IlsRecord must not be padded");
+
+/**
+ * Measures the AM modulation of an ILS signal (localizer or glide slope) from
+ * its filtered IQ samples.
+ *
+ * The envelope of the signal is the modulus of the samples.  Its mean is the
+ * carrier, and its correlation with a cosine and a sine at each tone gives the
+ * amplitude of the tone; both are computed over windows of a fixed length.
+ * The cosines and sines of a window are tabulated, so the loop over the
+ * samples only has reductions, and is vectorised.
+ *
+ * Windows of 100 ms hold a whole number of periods of all tones, so they do
+ * not leak into each other.
+ */
+class IlsMeter {
+public:
+	IlsMeter() = delete;
+
+	/**
+	 * Creates a meter.  The tables are allocated here.
+	 *
+	 * @param rate The rate of the samples, in Hz.
+	 * @param period The length of a window, in seconds.
+	 */
+	IlsMeter(double rate, double period);
+
+	IlsMeter(IlsMeter const &) = delete;
+	IlsMeter &operator=(IlsMeter const &) = delete;
+
+	/**
+	 * Returns the maximum amount of records that measure() writes for
+	 * `count' samples.
+	 */
+	size_t max_records(size_t count) const {
+		return count / window + 1;
+	}
+
+	/**
+	 * Measures a buffer of samples, following those of the previous call.
+	 * Never allocates memory.
+	 *
+	 * @param input The samples, with interleaved I and Q values.
+	 * @param count The amount of IQ samples.
+	 * @param time The time of the last sample, in nanoseconds since the
+	 *   Unix epoch.
+	 * @param records Where the records of the windows ending in this
+	 *   buffer are written.  See max_records().
+	 * @returns The amount of records written.
+	 */
+	size_t measure(float const *input, size_t count, int64_t time,
+		       IlsRecord *records);
+
+private:
+	/**
+	 * The tones, in Hz.
+	 */
+	static constexpr double tones[] {90, 150, 1020};
+	static constexpr size_t tone_count {3};
+
+	void accumulate(float const *input, size_t count);
+	IlsRecord record(int64_t time);
+
+	const double rate;
+	const size_t window;
+
+	// The cosine then the sine of each tone, over a window.
+	std::vector<float> tables;
+
+	// The sums over the current window.
+	size_t position {0};
+	double envelope {0};
+	double correlations[tone_count * 2] {};
+};
+
+#endif  /* __ILSIMU_RASSEIVER_ILS_METER_HPP */
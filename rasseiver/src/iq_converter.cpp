@@ -0,0 +1,85 @@
+#include "iq_converter.hpp"
+
+#include <algorithm>
+
+#include <cmath>
+
+constexpr size_t IqConverter::taps;
+constexpr size_t IqConverter::block;
+
+IqConverter::IqConverter(size_t max_count, int node):
+	i (taps - 1 + max_count / 2, PageAllocator<int16_t> {"converter", node}),
+	q (taps - 1 + max_count / 2, PageAllocator<int16_t> {"converter", node}),
+	output (max_count, PageAllocator<int16_t> {"converter", node}) {
+	// The odd coefficients of a Blackman windowed half-band filter
+	// at the rate of the Q components, centered between the coefficients
+	// taps / 2 - 1 and taps / 2.
+	std::array<double, taps> h;
+	double sum {0};
+
+	for (size_t k = 0; k < taps; k++) {
+		const double x {k - (taps - 1) / 2.0};
+		const double w {2 * M_PI * (k * 2 + 1) / (taps * 2)};
+
+		h[k] = std::sin(M_PI * x) / (M_PI * x) *
+			(0.42 - 0.5 * std::cos(w) + 0.08 * std::cos(2 * w));
+		sum += h[k];
+	}
+
+	// Scaled so that the gain of both branches is 1.
+	for (size_t k = 0; k < taps; k++) {
+		coefficients[k] = static_cast<int16_t> (
+			std::lround(h[k] / sum * 32768));
+	}
+}
+
+int16_t *IqConverter::convert(uint16_t const *input, size_t count) {
+	const size_t n {count / 2};
+	int16_t *is {i.data() + taps - 1}, *qs {q.data() + taps - 1};
+	const int sign {odd ? -1 : 1};
+
+	// Translation by fs/4, removing the offset of the ADC.
+#pragma omp simd
+	for (size_t m = 0; m < n; m++) {
+		const int s {(m & 1) ? -sign : sign};
+
+		is[m] = static_cast<int16_t> (s * (input[m * 2] - 2048));
+		qs[m] = static_cast<int16_t> (-s * (input[m * 2 + 1] - 2048));
+	}
+
+	// The I components are delayed by taps / 2 - 1 samples, the delay of
+	// the filter interpolating the Q components at their times.
+	int16_t const *h {coefficients.data()};
+	int16_t const *id {i.data() + taps / 2};
+
+	// By blocks of outputs, so that the loops over the outputs, rather
+	// than over the short filter, are vectorised.
+	for (size_t first = 0; first < n; first += block) {
+		const size_t end {std::min(n, first + block)};
+		std::array<int32_t, block> values {};
+
+		for (size_t k = 0; k < taps; k++) {
+			int16_t const *x {q.data() + k};
+			const int32_t c {h[k]};
+
+#pragma omp simd
+			for (size_t m = first; m < end; m++) {
+				values[m - first] += x[m] * c;
+			}
+		}
+
+#pragma omp simd
+		for (size_t m = first; m < end; m++) {
+			output[m * 2] = id[m];
+			output[m * 2 + 1] = static_cast<int16_t> (
+				(values[m - first] + (1 << 14)) >> 15);
+		}
+	}
+
+	// The end of the buffer is the history of the next one.
+	std::copy_n(i.data() + n, taps - 1, i.data());
+	std::copy_n(q.data() + n, taps - 1, q.data());
+	odd ^= n & 1;
+
+	return output.data();
+}
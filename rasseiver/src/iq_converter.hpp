@@ -0,0 +1,77 @@
+#ifndef __ILSIMU_RASSEIVER_IQ_CONVERTER_HPP
+# define __ILSIMU_RASSEIVER_IQ_CONVERTER_HPP
+
+# include <array>
+
+# include <cstddef>
+# include <cstdint>
+
+# include "page_allocator.hpp"
+
+/**
+ * Converts the real samples of the ADC of an Airspy into IQ samples at half
+ * their rate, instead of libairspy.
+ *
+ * The ADC samples the IF at four times its center frequency, so the signal
+ * is translated by fs/4 by multiplying the samples by 1, -j, -1, j, ... (the
+ * direction of libairspy).  The even samples become the I components, and
+ * the odd ones the Q components, half a sample later.  A half-band filter
+ * then brings the Q components back to the time of the I ones, and rejects
+ * the image: of its polyphase branches, the one of the I components is a
+ * delay, so only the Q components are filtered, by `taps' coefficients.
+ *
+ * The samples are the raw 12 bits codes of the ADC, and the IQ samples keep
+ * their scale: they are centered on 0, and do not exceed 2048, but for the
+ * overshoot of the filter.  Coefficients and samples are 16 bits integers
+ * and the products are accumulated in 32 bits integers, so the loops are
+ * vectorised.
+ */
+class IqConverter {
+public:
+	IqConverter() = delete;
+
+	/**
+	 * Designs the filter, and allocates the buffers.
+	 *
+	 * @param max_count The max amount of real samples of a buffer.
+	 * @param node The NUMA node of the buffers, or -1.
+	 */
+	explicit IqConverter(size_t max_count, int node = -1);
+
+	IqConverter(IqConverter const &) = delete;
+	IqConverter &operator=(IqConverter const &) = delete;
+
+	/**
+	 * Converts a buffer of real samples.  The buffers are contiguous: the
+	 * end of the previous one is the history of the filter.
+	 *
+	 * This does not allocate memory, so it may be called from a device
+	 * callback.
+	 *
+	 * @param input The raw samples, between 0 and 4095.
+	 * @param count The amount of samples, even, and at most `max_count'.
+	 * @returns The interleaved IQ samples, `count' values, valid until the
+	 *   next call.
+	 */
+	int16_t *convert(uint16_t const *input, size_t count);
+
+	/**
+	 * The amount of coefficients applied to the Q components.  The
+	 * half-band filter has 2 * taps - 1 coefficients.
+	 */
+	static constexpr size_t taps {24};
+
+private:
+	// The amount of outputs computed together.
+	static constexpr size_t block {256};
+
+	// The history of both components, then those of the current buffer.
+	PageVector<int16_t> i, q;
+	PageVector<int16_t> output;
+	std::array<int16_t, taps> coefficients;
+
+	// Whether the first sample of the next buffer is an odd one.
+	bool odd {false};
+};
+
+#endif  /* __ILSIMU_RASSEIVER_IQ_CONVERTER_HPP */
@@ -0,0 +1,245 @@
+#include <array>
+#include <cstdarg>
+#include <cstdio>
+
+#include <cerrno>
+#include <semaphore.h>
+#include <syslog.h>
+
+#include "log.hpp"
+
+/**
+ * A message waiting to be written.
+ */
+struct LogRecord {
+	// See LogRing.
+	std::atomic<size_t> sequence;
+	LogLevel level;
+	char text[240];
+};
+
+/**
+ * A bounded, lock-free, multiple producers and single consumer queue of
+ * records (Vyukov's bounded queue).  Each slot holds the position at which it
+ * may be written next, or this position + 1 once it has been written, so
+ * producers reserve a slot with a single compare-and-swap, and the consumer
+ * waits for nothing.
+ */
+class LogRing {
+public:
+	LogRing() {
+		for (size_t i = 0; i < slots.size(); i++) {
+			slots[i].sequence.store(i, std::memory_order_relaxed);
+		}
+
+		sem_init(&available, 0, 0);
+	}
+
+	/**
+	 * Reserves a record.  Must be followed by commit().
+	 *
+	 * @returns The record, or nullptr if the ring is full.
+	 */
+	LogRecord *reserve() {
+		size_t pos {tail.load(std::memory_order_relaxed)};
+
+		for (;;) {
+			LogRecord &slot {slots[pos % slots.size()]};
+			const size_t sequence {
+				slot.sequence.load(std::memory_order_acquire)};
+
+			if (sequence == pos) {
+				if (tail.compare_exchange_weak(
+					    pos, pos + 1,
+					    std::memory_order_relaxed)) {
+					return &slot;
+				}
+			} else if (sequence < pos) {
+				lost.fetch_add(1, std::memory_order_relaxed);
+				return nullptr;
+			} else {
+				pos = tail.load(std::memory_order_relaxed);
+			}
+		}
+	}
+
+	/**
+	 * Hands a written record to the consumer.  Never blocks.
+	 */
+	void commit(LogRecord *record) {
+		record->sequence.store(
+			record->sequence.load(std::memory_order_relaxed) + 1,
+			std::memory_order_release);
+		sem_post(&available);
+	}
+
+	/**
+	 * Returns the oldest record, or nullptr if there is none.  Must be
+	 * followed by release().
+	 */
+	LogRecord *front() {
+		LogRecord &slot {slots[head % slots.size()]};
+
+		if (slot.sequence.load(std::memory_order_acquire) != head + 1) {
+			return nullptr;
+		}
+
+		return &slot;
+	}
+
+	void release(LogRecord *record) {
+		record->sequence.store(head + slots.size(),
+				       std::memory_order_release);
+		head++;
+	}
+
+	/**
+	 * Waits for a record, or for wake().
+	 */
+	void wait() {
+		while (sem_wait(&available) && errno == EINTR) {
+		}
+	}
+
+	void wake() {
+		sem_post(&available);
+	}
+
+	uint64_t take_lost() {
+		return lost.exchange(0, std::memory_order_relaxed);
+	}
+
+private:
+	std::array<LogRecord, 256> slots;
+	std::atomic<size_t> tail {0};
+	size_t head {0};
+	std::atomic<uint64_t> lost {0};
+	sem_t available;
+};
+
+static LogRing ring;
+
+/**
+ * Formats a message into a record of the ring.
+ *
+ * @param level The severity of the message.
+ * @param suppressed The amount of messages suppressed before this one.
+ * @param format The printf() format of the message.
+ * @param args The arguments of the format.
+ */
+static void log_vmessage(LogLevel level, uint64_t suppressed,
+			 char const *format, va_list args) {
+	LogRecord *record {ring.reserve()};
+
+	if (record == nullptr) {
+		return;
+	}
+
+	int length {std::vsnprintf(record->text, sizeof(record->text), format,
+				   args)};
+
+	if (suppressed > 0 && length >= 0 &&
+	    static_cast<size_t> (length) < sizeof(record->text)) {
+		std::snprintf(record->text + length,
+			      sizeof(record->text) - length,
+			      " (%lu similar messages suppressed)",
+			      static_cast<unsigned long> (suppressed));
+	}
+
+	record->level = level;
+	ring.commit(record);
+}
+
+void log_message(LogLevel level, char const *format, ...) {
+	va_list args;
+
+	va_start(args, format);
+	log_vmessage(level, 0, format, args);
+	va_end(args);
+}
+
+bool LogLimit::allow() {
+	const int64_t now {std::chrono::duration_cast<std::chrono::nanoseconds> (
+			std::chrono::steady_clock::now().time_since_epoch())
+			.count()};
+	int64_t previous {last.load(std::memory_order_relaxed)};
+
+	return (previous == INT64_MIN || now - previous >= interval) &&
+		last.compare_exchange_strong(previous, now,
+					     std::memory_order_relaxed);
+}
+
+bool log_limited(LogLimit &limit, LogLevel level, char const *format, ...) {
+	va_list args;
+
+	if (!limit.allow()) {
+		limit.suppress();
+		return false;
+	}
+
+	va_start(args, format);
+	log_vmessage(level, limit.take_suppressed(), format, args);
+	va_end(args);
+
+	return true;
+}
+
+LogWriter::LogWriter(bool syslog): syslog {syslog} {
+	if (syslog) {
+		openlog("rasseiver", LOG_PID, LOG_DAEMON);
+	}
+
+	thd = std::thread {&LogWriter::run, this};
+}
+
+LogWriter::~LogWriter() {
+	stopping = true;
+	ring.wake();
+	thd.join();
+
+	if (syslog) {
+		closelog();
+	}
+}
+
+void LogWriter::run() {
+	while (!stopping) {
+		ring.wait();
+		drain();
+	}
+
+	drain();
+}
+
+void LogWriter::write(LogLevel level, char const *text) {
+	if (syslog) {
+		::syslog(level == LogLevel::error ? LOG_ERR :
+			 level == LogLevel::warning ? LOG_WARNING : LOG_INFO,
+			 "%s", text);
+	} else {
+		std::fprintf(level == LogLevel::info ? stdout : stderr, "%s\n",
+			     text);
+	}
+}
+
+void LogWriter::drain() {
+	LogRecord *record;
+
+	while ((record = ring.front()) != nullptr) {
+		write(record->level, record->text);
+		ring.release(record);
+	}
+
+	const uint64_t lost {ring.take_lost()};
+
+	if (lost > 0) {
+		char text[64];
+
+		std::snprintf(text, sizeof(text), "%lu log messages lost",
+			      static_cast<unsigned long> (lost));
+		write(LogLevel::warning, text);
+	}
+
+	std::fflush(stdout);
+	std::fflush(stderr);
+}
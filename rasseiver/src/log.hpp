@@ -0,0 +1,137 @@
+#ifndef __ILSIMU_RASSEIVER_LOG_HPP
+# define __ILSIMU_RASSEIVER_LOG_HPP
+
+# include <atomic>
+# include <chrono>
+# include <cstdint>
+# include <thread>
+
+/**
+ * The severity of a message.  Informations are written to the standard
+ * output, warnings and errors to the error output.
+ */
+enum class LogLevel {
+	info,
+	warning,
+	error,
+};
+
+/**
+ * Logs a message from any thread, without blocking nor allocating memory.
+ *
+ * The message is formatted with vsnprintf() into a record of a preallocated
+ * lock-free ring, and written later by the thread of the LogWriter.  Messages
+ * longer than a record are truncated.  If the ring is full, the message is
+ * dropped, and counted.
+ *
+ * @param level The severity of the message.
+ * @param format The printf() format of the message.
+ */
+void log_message(LogLevel level, char const *format, ...)
+	__attribute__ ((format (printf, 2, 3)));
+
+/**
+ * Limits the rate of the messages of a call site, usually a member next to
+ * it.  See log_limited().
+ */
+class LogLimit {
+public:
+	LogLimit() = delete;
+
+	/**
+	 * @param interval The minimum time between two messages.
+	 */
+	explicit LogLimit(std::chrono::milliseconds interval):
+		interval {std::chrono::duration_cast<std::chrono::nanoseconds> (
+				interval).count()} {
+	}
+
+	LogLimit(LogLimit const &) = delete;
+	LogLimit &operator=(LogLimit const &) = delete;
+
+	/**
+	 * Returns whether a message may be logged now, ie. if the last one
+	 * was logged at least `interval' ago.  If so, now becomes the time of
+	 * the last message.
+	 */
+	bool allow();
+
+	/**
+	 * Counts a suppressed message.
+	 */
+	void suppress() {
+		suppressed.fetch_add(1, std::memory_order_relaxed);
+	}
+
+	/**
+	 * Returns the amount of messages suppressed since the last call, and
+	 * resets it.
+	 */
+	uint64_t take_suppressed() {
+		return suppressed.exchange(0, std::memory_order_relaxed);
+	}
+
+private:
+	const int64_t interval;
+	std::atomic<int64_t> last {INT64_MIN};
+	std::atomic<uint64_t> suppressed {0};
+};
+
+/**
+ * Logs a message like log_message(), unless a message of the same call site
+ * was logged less than the interval of the limit ago.  The amount of messages
+ * suppressed in between is appended to the next one.
+ *
+ * Callers reporting counters rather call log_message() when
+ * LogLimit::allow() returns true, and only reset their counters then, so
+ * that the next message aggregates the suppressed ones.
+ *
+ * @param limit The limit of the call site.
+ * @param level The severity of the message.
+ * @param format The printf() format of the message.
+ * @returns true if the message was logged.
+ */
+bool log_limited(LogLimit &limit, LogLevel level, char const *format, ...)
+	__attribute__ ((format (printf, 3, 4)));
+
+/**
+ * Writes the logged messages to the standard outputs, or to syslog, on its
+ * own thread.  There should be a single writer, created at startup: the
+ * messages logged before are kept in the ring until it starts.  The remaining
+ * messages are written when it is destroyed.
+ */
+class LogWriter {
+public:
+	LogWriter() = delete;
+
+	/**
+	 * Starts the thread.
+	 *
+	 * @param syslog Whether messages are written to syslog instead of the
+	 *   standard outputs.
+	 */
+	explicit LogWriter(bool syslog);
+
+	/**
+	 * Writes the remaining messages, and stops the thread.
+	 */
+	~LogWriter();
+
+	LogWriter(LogWriter const &) = delete;
+	LogWriter &operator=(LogWriter const &) = delete;
+
+private:
+	void run();
+	void write(LogLevel level, char const *text);
+
+	/**
+	 * Writes the messages of the ring.
+	 */
+	void drain();
+
+	const bool syslog;
+	std::atomic<bool> stopping {false};
+	std::thread thd;
+};
+
+#endif  /* __ILSIMU_RASSEIVER_LOG_HPP */
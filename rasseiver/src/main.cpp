@@ -1,73 +1,224 @@
+#include <algorithm>
+#include <chrono>
 #include <iostream>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
 
 // Signal handling
 #include <csignal>
 #include <pthread.h>
-#include <unistd.h>
 
 #include "config.hpp"
-#include "device_airspy.hpp"
-#include "device_dummy.hpp"
-#include "device_rspduo.hpp"
-#include "filter.hpp"
+#include "log.hpp"
+#include "page_allocator.hpp"
+#include "pipeline.hpp"
+#include "realtime.hpp"
+#include "supervisor.hpp"
 
-static int wait(unsigned int seconds, sigset_t const &set) {
-	int sig;
+/**
+ * Reload the filters of running pipelines from the config file.  The sections
+ * of the file must not have changed since the pipelines were created.  Errors
+ * are reported, and the pipelines they concern keep their current filter.
+ *
+ * @param file The config file, or an empty string if there is none.
+ * @param pipelines The running pipelines, one for each section.
+ */
+static void reload_pipelines(
+	std::string const &file,
+	std::vector<std::unique_ptr<Pipeline>> &pipelines) {
+	ConfigMap config {config_default};
+	std::vector<ConfigSection> sections;
 
-	alarm(seconds);
+	if (file.empty()) {
+		std::cerr << "No config file to reload" << std::endl;
+		return;
+	}
 
-	// Wait until we receive a signal
-	sigwait(&set, &sig);
+	std::cout << "Reloading the filters" << std::endl;
 
-	return sig;
+	try {
+		sections = config_read_sections(file, config);
+	} catch (std::runtime_error &e) {
+		std::cerr << e.what() << std::endl;
+		return;
+	}
+
+	bool same_sections {sections.size() == pipelines.size()};
+
+	for (size_t i = 0; same_sections && i < sections.size(); i++) {
+		same_sections = sections[i].name == pipelines[i]->name();
+	}
+
+	if (!same_sections) {
+		std::cerr << "The sections of the config file changed, "
+			  << "restart to apply them" << std::endl;
+		return;
+	}
+
+	for (size_t i = 0; i < sections.size(); i++) {
+		try {
+			pipelines[i]->reload(sections[i].config);
+		} catch (std::runtime_error &e) {
+			if (!sections[i].name.empty()) {
+				std::cerr << "[" << sections[i].name << "] ";
+			}
+
+			std::cerr << e.what() << std::endl;
+		}
+	}
+}
+
+/**
+ * The state of the supervision of a pipeline.
+ */
+struct Supervision {
+	bool failing {false}; // The last restart failed, it is retried
+	bool ended {false};   // The device cannot be reopened
+};
+
+/**
+ * Restarts the device of a pipeline if it stopped streaming, or if it
+ * stalled.  If it cannot be opened again (eg. it is unplugged), the error is
+ * reported once, and the restart is retried at the next check, while the
+ * other pipelines keep running.
+ *
+ * @param pipeline The pipeline.
+ * @param stall_timeout The longest time without buffers, or 0 to only check
+ *   that the device is streaming.
+ * @param state The state of the supervision of the pipeline.
+ */
+static void supervise(Pipeline &pipeline,
+		      std::chrono::milliseconds stall_timeout,
+		      Supervision &state) {
+	const std::string prefix {pipeline.name().empty() ? "" :
+			"[" + pipeline.name() + "] "};
+	std::string reason;
+	bool restarted;
+
+	if (!pipeline.is_streaming()) {
+		reason = "Device stopped streaming";
+	} else if (stall_timeout.count() > 0 &&
+		   pipeline.is_stalled(stall_timeout)) {
+		reason = "Device stalled";
+	} else {
+		return;
+	}
+
+	const auto start = std::chrono::steady_clock::now();
+
+	try {
+		restarted = pipeline.restart();
+	} catch (std::runtime_error &e) {
+		if (!state.failing) {
+			std::cerr << prefix << reason << ", could not restart "
+				  << "it (" << e.what() << "), retrying"
+				  << std::endl;
+			state.failing = true;
+		}
+
+		return;
+	}
+
+	if (!restarted) {
+		std::cerr << prefix << reason << std::endl;
+		state.ended = true;
+		return;
+	}
+
+	state.failing = false;
+	std::cerr << prefix << reason << ", restarted it in "
+		  << std::chrono::duration<double, std::milli> (
+			  std::chrono::steady_clock::now() - start).count()
+		  << " ms" << std::endl;
 }
 
 /**
- * Run the program with the specified device.  Stops when a signal in
- * the sigset is received.
+ * Run the pipelines described by the config sections.  Stops when a signal is
+ * received, except for SIGHUP which reloads the filters.
  *
- * TODO: sigset should be part of another function, perhaps.
+ * The devices are checked at a quarter of the stall timeout, and restarted
+ * if they stalled or stopped streaming.  A device which cannot be restarted
+ * only stops its own pipeline; once every device is stopped for good, a
+ * std::runtime_error is thrown.
  *
- * @param device The device to use
- * @param config The configuration of the device.
- * @param filter The filter to be used on the input signal.
- * @param set List of signals to wait for.
+ * @param sections The config sections, one for each device.
+ * @param file The config file the sections were read from, or an empty
+ *   string.
+ * @param workers The threads helping to filter, shared by all pipelines.
+ * @param supervisor The signals and the timer to wait for.
+ * @param stall_timeout The longest time without buffers, or 0 to only check
+ *   every second that the devices are streaming.
+ * @returns The signal which stopped the pipelines.
  */
-template<typename T>
-static void run_device(Device<T> &device, ConfigMap const &config,
-		       Filter const &filter, sigset_t const &set) {
-	Process<T> process {device.buffer_size(), filter,
-			config.at("decimation"), device.max_value(),
-			config.at("host").get_value(), config.at("port")};
+static int run_pipelines(std::vector<ConfigSection> const &sections,
+			 std::string const &file, WorkerPool &workers,
+			 Supervisor &supervisor,
+			 std::chrono::milliseconds stall_timeout) {
+	std::vector<std::unique_ptr<Pipeline>> pipelines;
+	std::vector<Supervision> states (sections.size());
 	int sig;
 
+	// Start receiving data from the devices
+	for (auto &section: sections) {
+		if (!section.name.empty()) {
+			std::cout << "Starting [" << section.name << "]"
+				  << std::endl;
+		}
+
+		pipelines.push_back(make_pipeline(section, workers));
+	}
+
+	page_report();
+
 	std::cout << "hello, world" << std::endl;
 
-	// Start receiving data from the device
-	Receiver<T> receiver {device, process};
+	supervisor.set_timer(stall_timeout.count() > 0 ?
+			     std::max(stall_timeout / 4,
+				      std::chrono::milliseconds {10}) :
+			     std::chrono::milliseconds {1000});
 
-	do {
-		sig = wait(1, set);
-		// Check every second that the device is still streaming
-	} while (sig == SIGALRM && device.is_streaming());
+	for (;;) {
+		sig = supervisor.wait();
+
+		if (sig == SIGHUP) {
+			reload_pipelines(file, pipelines);
+			continue;
+		}
+
+		if (sig != 0) {
+			break;
+		}
 
-	if (sig == SIGALRM) {
-		// If the signal received is an alarm and we are
-		// outside of the loop, it means the device stopped
-		// streaming.  In this case, throw an exception.
-		throw std::runtime_error {"Device stopped streaming"};
+		size_t ended {0};
+
+		for (size_t i = 0; i < pipelines.size(); i++) {
+			if (!states[i].ended) {
+				supervise(*pipelines[i], stall_timeout,
+					  states[i]);
+			}
+
+			ended += states[i].ended;
+		}
+
+		if (ended == pipelines.size()) {
+			throw std::runtime_error {"No device is streaming"};
+		}
 	}
 
-	// Stop receiving data from the device and close the process.
+	// Stop receiving data from the devices and close the processes.
 	// This is automatically handled by the compiler thanks to
 	// RAII.
+	return sig;
 }
 
 /**
  * Init a sigset_t and use it as a signal mask for every threads.
  *
  * The initialisation step consists of clearing the mask, and adding SIGINT,
- * SIGTERM and SIGALRM to the mask.
+ * SIGTERM and SIGHUP to the mask.
  *
  * @param set The signal set to init.
  */
@@ -75,7 +226,7 @@ static int setup_sigmask(sigset_t &set) {
 	sigemptyset(&set);
 	sigaddset(&set, SIGINT);
 	sigaddset(&set, SIGTERM);
-	sigaddset(&set, SIGALRM);
+	sigaddset(&set, SIGHUP);
 
 	if (pthread_sigmask(SIG_BLOCK, &set, nullptr)) {
 		perror("pthread_sigmask()");
@@ -87,7 +238,8 @@ static int setup_sigmask(sigset_t &set) {
 
 int main(int argc, char **argv) {
 	ConfigMap config {config_default};
-	Filter filter;
+	std::vector<ConfigSection> sections;
+	std::string file;
 	sigset_t set;
 
 	// Check program parameters
@@ -100,12 +252,16 @@ int main(int argc, char **argv) {
 		// If only one parameter was specified, treat it as the path to
 		// a config file, and read it.
 		std::cout << "Using config file" << std::endl;
-		config_read_file(argv[1], config);
-	}
+		file = argv[1];
 
-	// Read the filter from the disk, if provided
-	if (config.count("filter") > 0) {
-		filter_read_file(config["filter"].get_value(), filter);
+		try {
+			sections = config_read_sections(file, config);
+		} catch (std::runtime_error &e) {
+			std::cerr << e.what() << std::endl;
+			return EXIT_FAILURE;
+		}
+	} else {
+		sections.push_back({"", config});
 	}
 
 	// Setup signals
@@ -113,60 +269,66 @@ int main(int argc, char **argv) {
 		return EXIT_FAILURE;
 	}
 
+	// The threads of the pipelines log through it, as they must not
+	// block on the outputs.
+	LogWriter log_writer {config.at("log") == "syslog"};
+
+	// Opening an Airspy by its serial number, or an RSPduo, may fail while
+	// it is being plugged, so it is retried.
 	bool retry {false};
 	int sig {};
+	const std::chrono::milliseconds stall_timeout {
+		static_cast<unsigned int> (config.at("stall_timeout"))};
+	std::unique_ptr<Supervisor> supervisor;
 
-	do {
-		try {
-			// Check the device type, and call the appropriate function
-			if (config["device"] == "airspy") {
-				// Determine which airspy to use
-				if (config.count("serial_number") > 0) {
-					retry = true;
-
-					Airspy airspy {config.at("serial_number"),
-							config.at("frequency"),
-							config.at("sample_rate"),
-							AIRSPY_SAMPLE_INT16_IQ};
-					run_device(airspy, config, filter, set);
-				} else {
-					Airspy airspy {config.at("frequency"),
-							config.at("sample_rate"),
-							AIRSPY_SAMPLE_INT16_IQ};
-					run_device(airspy, config, filter, set);
-				}
-
-			} else if (config["device"] == "dummy") {
-				DummyDevice dummy {config.at("count")};
-				run_device(dummy, config, filter, set);
-			} else if (config["device"] == "rspduo") {
-				// Determine which airspy to use
-
-					RSPDuo rspduo {config.at("frequency"),
-							config.at("sample_rate")};
-					run_device(rspduo, config, filter, set);
+	try {
+		supervisor = std::make_unique<Supervisor> (set);
+	} catch (std::runtime_error &e) {
+		std::cerr << e.what() << std::endl;
+		return EXIT_FAILURE;
+	}
 
+	for (auto &section: sections) {
+		if ((section.config.at("device") == "airspy" &&
+		     section.config.count("serial_number") > 0) ||
+		    section.config.at("device") == "rspduo") {
+			retry = true;
+		}
+	}
 
-			}
+	// The threads of the device callbacks filter too.
+	unsigned int threads {config.at("filter_threads")};
 
+	if (threads == 0) {
+		threads = std::max(1u, std::thread::hardware_concurrency());
+	}
 
-			 else {
-				// Unknown device
-				std::cerr << "Unknown device type \""
-					  << config["device"].get_value()
-					  << "\"" << std::endl;
-				return EXIT_FAILURE;
-			}
+	// Two slots for each pipeline, as the engine replacing another on
+	// reload is created before the old one is destroyed.
+	WorkerPool workers {threads - 1, sections.size() * 2,
+			    thread_policy(config, "filter")};
+
+	// Every buffer is allocated when the pipelines are created, so they
+	// are all locked.
+	if (static_cast<int> (config.at("lock_memory")) != 0) {
+		lock_memory();
+	}
+
+	do {
+		try {
+			sig = run_pipelines(sections, file, workers,
+					    *supervisor, stall_timeout);
 		} catch (std::runtime_error &e) {
 			std::cerr << e.what() << std::endl;
 
 			if (retry) {
-				sig = wait(1, set);
+				supervisor->set_timer(std::chrono::seconds {1});
+				sig = supervisor->wait();
 			} else {
 				return EXIT_FAILURE;
 			}
 		}
-	} while (retry && sig == SIGALRM);
+	} while (retry && (sig == 0 || sig == SIGHUP));
 
 	return EXIT_SUCCESS;
 }
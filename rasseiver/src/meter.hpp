@@ -0,0 +1,104 @@
+#ifndef __ILSIMU_RASSEIVER_METER_HPP
+# define __ILSIMU_RASSEIVER_METER_HPP
+
+# include <cstddef>
+# include <cstdint>
+
+/**
+ * Statistics about a raw input block, before any filtering.  This is what
+ * actually clips, so it is a better saturation indicator than the filtered
+ * output.
+ *
+ * The layout of this structure is also its layout on the network (see
+ * protocol_metering_size in protocol.hpp), as it is sent as it is by
+ * Sender::send_block() on the SenderThread, so it must not contain any
+ * padding.
+ */
+struct Metering {
+	/**
+	 * The highest absolute value of the I channel in the block.
+	 */
+	uint16_t peak_i;
+
+	/**
+	 * The highest absolute value of the Q channel in the block.
+	 */
+	uint16_t peak_q;
+
+	/**
+	 * The amount of IQ samples whose modulus is higher or equal to the
+	 * saturation threshold.
+	 */
+	uint32_t clipped;
+
+	/**
+	 * The mean power of the block, ie. the mean of I^2 + Q^2, in squared
+	 * raw units.
+	 */
+	float power;
+};
+
+static_assert(sizeof(Metering) == 12, "Metering must not be padded");
+
+/**
+ * Computes the statistics of a raw block of interleaved I and Q samples.
+ *
+ * The modulus of each sample is compared to the threshold with squared values,
+ * so no square root is needed.  The loop has no branch and only uses
+ * reductions, so the compiler is able to vectorise it.
+ *
+ * @param input The raw samples, with interleaved I and Q values.
+ * @param count The amount of values in `input' (ie. twice the amount of IQ
+ *   samples).
+ * @param threshold The saturation threshold.
+ * @param metering Where the results are stored.
+ */
+template<typename T>
+void meter_buffer(T const *input, size_t count, int threshold,
+		  Metering &metering) {
+	const int64_t threshold2 {static_cast<int64_t> (threshold) * threshold};
+	int32_t peak_i {}, peak_q {};
+	uint32_t clipped {};
+	int64_t power {};
+
+#pragma omp simd reduction(max: peak_i, peak_q) reduction(+: clipped, power)
+	for (size_t n = 0; n < count; n += 2) {
+		int32_t i {input[n]}, q {input[n + 1]};
+		int64_t modulus2 {static_cast<int64_t> (i) * i +
+				static_cast<int64_t> (q) * q};
+
+		i = i < 0 ? -i : i;
+		q = q < 0 ? -q : q;
+
+		peak_i = i > peak_i ? i : peak_i;
+		peak_q = q > peak_q ? q : peak_q;
+		clipped += modulus2 >= threshold2;
+		power += modulus2;
+	}
+
+	metering.peak_i = static_cast<uint16_t> (peak_i);
+	metering.peak_q = static_cast<uint16_t> (peak_q);
+	metering.clipped = clipped;
+	metering.power = count > 0 ? static_cast<float> (power) / (count / 2) : 0;
+}
+
+/**
+ * Adds the statistics of a raw block to the statistics of the previous blocks,
+ * as if they had been computed on all the blocks at once.  All the blocks
+ * must have the same size.
+ *
+ * @param metering The statistics of the previous blocks, updated.
+ * @param block The statistics of the new block.
+ * @param count The amount of previous blocks.
+ */
+inline void merge_metering(Metering &metering, Metering const &block,
+			   size_t count) {
+	metering.peak_i = block.peak_i > metering.peak_i ? block.peak_i :
+		metering.peak_i;
+	metering.peak_q = block.peak_q > metering.peak_q ? block.peak_q :
+		metering.peak_q;
+	metering.clipped += block.clipped;
+	metering.power = (metering.power * count + block.power) / (count + 1);
+}
+
+#endif  /* __ILSIMU_RASSEIVER_METER_HPP */
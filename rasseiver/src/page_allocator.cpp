@@ -0,0 +1,210 @@
+#include <iostream>
+#include <map>
+#include <mutex>
+#include <new>
+#include <string>
+#include <tuple>
+
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+
+#include <dirent.h>
+#include <linux/mempolicy.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include "page_allocator.hpp"
+
+/**
+ * The size of a huge page.  It is 2 MiB on x86-64 and on most ARM64 kernels,
+ * which are the only ones on which huge pages are used here.
+ */
+static constexpr size_t huge_page_size {2 * 1024 * 1024};
+
+/**
+ * The size from which a buffer is backed by huge pages.  The input buffers of
+ * the devices are a few hundred KiB, so rounding them up to a huge page wastes
+ * some memory, but saves hundreds of TLB entries.
+ */
+static constexpr size_t huge_threshold {huge_page_size / 8};
+
+/**
+ * How the pages of a buffer were obtained.
+ */
+enum class Backing {
+	hugetlb,     // Huge pages from the hugetlbfs pool
+	transparent, // Transparent huge pages
+	normal,      // Normal pages
+};
+
+/**
+ * The buffers of a given name and backing, for page_report().
+ */
+struct Record {
+	size_t count;
+	size_t bytes;
+};
+
+static std::mutex records_mutex;
+static std::map<std::tuple<std::string, Backing, int>, Record> records;
+
+static size_t round_up(size_t size, size_t alignment) {
+	return (size + alignment - 1) / alignment * alignment;
+}
+
+/**
+ * Returns the size of the mapping of a buffer of `size' bytes.  It only
+ * depends on the size, so page_free() can find it.
+ */
+static size_t mapping_size(size_t size) {
+	if (size >= huge_threshold) {
+		return round_up(size, huge_page_size);
+	}
+
+	return round_up(size, static_cast<size_t> (sysconf(_SC_PAGESIZE)));
+}
+
+static void *map(size_t length, int flags) {
+	return mmap(nullptr, length, PROT_READ | PROT_WRITE,
+		    MAP_PRIVATE | MAP_ANONYMOUS | flags, -1, 0);
+}
+
+/**
+ * Maps `length' bytes aligned on a huge page, and asks for transparent huge
+ * pages.
+ *
+ * @param length The length of the mapping, a multiple of huge_page_size.
+ * @param backing Where the backing of the mapping is stored.
+ */
+static void *map_aligned(size_t length, Backing &backing) {
+	// Map more than needed, and unmap what is not aligned.
+	auto *data = static_cast<uint8_t *> (map(length + huge_page_size, 0));
+
+	if (data == MAP_FAILED) {
+		return data;
+	}
+
+	const size_t head {round_up(reinterpret_cast<uintptr_t> (data),
+				    huge_page_size) -
+			   reinterpret_cast<uintptr_t> (data)};
+
+	if (head > 0) {
+		munmap(data, head);
+	}
+
+	munmap(data + head + length, huge_page_size - head);
+	data += head;
+
+	backing = madvise(data, length, MADV_HUGEPAGE) ?
+		Backing::normal : Backing::transparent;
+
+	return data;
+}
+
+/**
+ * Makes the pages of a mapping come from a node, and moves those already
+ * allocated.
+ *
+ * @returns true on success.
+ */
+static bool bind(void *data, size_t length, int node) {
+	if (node < 0 || node >= static_cast<int> (sizeof(unsigned long) * 8)) {
+		return false;
+	}
+
+	unsigned long mask {1ul << node};
+
+	return syscall(SYS_mbind, data, length, MPOL_PREFERRED, &mask,
+		       sizeof(mask) * 8, MPOL_MF_MOVE) == 0;
+}
+
+void *page_allocate(size_t size, char const *name, int node) {
+	const size_t length {mapping_size(size)};
+	Backing backing {Backing::normal};
+	void *data {MAP_FAILED};
+
+	if (size >= huge_threshold) {
+		data = map(length, MAP_HUGETLB);
+
+		if (data != MAP_FAILED) {
+			backing = Backing::hugetlb;
+		} else {
+			data = map_aligned(length, backing);
+		}
+	}
+
+	if (data == MAP_FAILED) {
+		data = map(length, 0);
+		backing = Backing::normal;
+	}
+
+	if (data == MAP_FAILED) {
+		throw std::bad_alloc {};
+	}
+
+	// Nothing has been written yet (unless the memory is locked), so the
+	// pages are allocated on the node when they are first written.
+	const bool on_node {node >= 0 && bind(data, length, node)};
+
+	std::lock_guard<std::mutex> lock {records_mutex};
+	Record &record {records[std::make_tuple(std::string {name}, backing,
+						on_node ? node : -1)]};
+
+	record.count++;
+	record.bytes += size;
+
+	return data;
+}
+
+void page_free(void *data, size_t size) {
+	munmap(data, mapping_size(size));
+}
+
+void page_report() {
+	std::lock_guard<std::mutex> lock {records_mutex};
+
+	for (auto &it: records) {
+		static char const *const backings[] {
+			"huge pages", "transparent huge pages", "normal pages",
+		};
+		const int node {std::get<2> (it.first)};
+
+		std::cout << "Memory: " << it.second.count << " "
+			  << std::get<0> (it.first) << " buffer(s), "
+			  << (it.second.bytes + 1023) / 1024 << " KiB, "
+			  << backings[static_cast<int> (std::get<1> (it.first))];
+
+		if (node >= 0) {
+			std::cout << " on node " << node;
+		}
+
+		std::cout << std::endl;
+	}
+
+	records.clear();
+}
+
+int cpu_node(int cpu) {
+	std::string path {"/sys/devices/system/cpu/cpu" + std::to_string(cpu)};
+	DIR *dir {opendir(path.c_str())};
+	int node {-1};
+
+	if (dir == nullptr) {
+		return -1;
+	}
+
+	// The directory of a CPU contains a link to its node, "node<N>".
+	while (dirent *entry = readdir(dir)) {
+		if (std::strncmp(entry->d_name, "node", 4) == 0 &&
+		    entry->d_name[4] >= '0' && entry->d_name[4] <= '9') {
+			node = std::atoi(entry->d_name + 4);
+			break;
+		}
+	}
+
+	closedir(dir);
+
+	return node;
+}
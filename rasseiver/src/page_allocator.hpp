@@ -0,0 +1,110 @@
+#ifndef __ILSIMU_RASSEIVER_PAGE_ALLOCATOR_HPP
+# define __ILSIMU_RASSEIVER_PAGE_ALLOCATOR_HPP
+
+# include <vector>
+
+# include <cstddef>
+
+/**
+ * Allocates a buffer directly from the kernel, with the biggest pages
+ * available, on a specific NUMA node.
+ *
+ * Buffers of at least an eighth of a huge page are backed, in order of
+ * preference, by huge pages from the hugetlbfs pool (MAP_HUGETLB), by
+ * transparent huge pages (an aligned mapping with MADV_HUGEPAGE), or by normal
+ * pages.  Smaller buffers are backed by normal pages.  If a node is specified, the pages are
+ * preferably taken from it (MPOL_PREFERRED), and from another node if it is
+ * full.
+ *
+ * The backing of each buffer is recorded for page_report().  If no memory is
+ * available, a std::bad_alloc is thrown.
+ *
+ * @param size The size of the buffer, in bytes.
+ * @param name What the buffer is used for, as printed by page_report().
+ * @param node The NUMA node of the pages, or -1 to let the kernel choose.
+ * @returns The buffer, filled with zeros.
+ */
+void *page_allocate(size_t size, char const *name, int node);
+
+/**
+ * Frees a buffer allocated with page_allocate().
+ *
+ * @param data The buffer.
+ * @param size The size given to page_allocate().
+ */
+void page_free(void *data, size_t size);
+
+/**
+ * Prints the backing of the buffers allocated since the last report, grouped
+ * by name.
+ */
+void page_report();
+
+/**
+ * Returns the NUMA node of a CPU, or -1 if it cannot be found (eg. on a
+ * machine without NUMA).
+ *
+ * @param cpu The CPU.
+ */
+int cpu_node(int cpu);
+
+/**
+ * A standard allocator using page_allocate(), so that any container can be
+ * backed by huge pages on a NUMA node.
+ *
+ * It is meant for big buffers allocated once, before entering real-time paths:
+ * each allocation is a system call.
+ */
+template<typename T>
+class PageAllocator {
+public:
+	using value_type = T;
+
+	/**
+	 * @param name What the buffers are used for.
+	 * @param node The NUMA node of the buffers, or -1.
+	 */
+	PageAllocator(char const *name = "buffer", int node = -1):
+		name {name}, node {node} {
+	}
+
+	template<typename U>
+	PageAllocator(PageAllocator<U> const &other):
+		name {other.name}, node {other.node} {
+	}
+
+	T *allocate(size_t n) {
+		return static_cast<T *> (page_allocate(n * sizeof(T), name,
+						       node));
+	}
+
+	void deallocate(T *data, size_t n) {
+		page_free(data, n * sizeof(T));
+	}
+
+	// Any allocator can free the buffers of another one.
+	template<typename U>
+	bool operator==(PageAllocator<U> const &) const {
+		return true;
+	}
+
+	template<typename U>
+	bool operator!=(PageAllocator<U> const &) const {
+		return false;
+	}
+
+private:
+	template<typename U>
+	friend class PageAllocator;
+
+	char const *name;
+	int node;
+};
+
+/**
+ * A std::vector backed by page_allocate().
+ */
+template<typename T>
+using PageVector = std::vector<T, PageAllocator<T>>;
+
+#endif  /* __ILSIMU_RASSEIVER_PAGE_ALLOCATOR_HPP */
@@ -0,0 +1,375 @@
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include <stdexcept>
+
+#include "autotune.hpp"
+#include "device_airspy.hpp"
+#include "device_dummy.hpp"
+#include "device_rspduo.hpp"
+#include "filter.hpp"
+#include "page_allocator.hpp"
+#include "pipeline.hpp"
+#include "scanner.hpp"
+
+/**
+ * Read the output parameters of a process from the configuration.
+ *
+ * @param config The configuration.
+ */
+static OutputOptions output_options(ConfigMap const &config) {
+	const double rate {
+		static_cast<unsigned int> (config.at("output_rate")) > 0 ?
+		static_cast<double> (config.at("output_rate")) :
+		static_cast<double> (config.at("sample_rate")) /
+		static_cast<int> (config.at("decimation"))};
+	const double block_ms {config.at("output_block_ms")};
+	unsigned int block_samples {config.at("output_block_samples")};
+
+	if (block_samples == 0 && block_ms > 0) {
+		block_samples = std::max(1u, static_cast<unsigned int> (
+						 block_ms * rate / 1000 + 0.5));
+	}
+
+	return {
+		config.at("host").get_value(),
+		static_cast<uint16_t> (static_cast<unsigned int> (
+					       config.at("port"))),
+		sample_format_from_string(config.at("output_format").get_value()),
+		config.at("output_scale"),
+		rate,
+		static_cast<double> (config.at("ils_period")) / 1000,
+		static_cast<double> (config.at("sample_rate")),
+		static_cast<int> (config.at("metering")) != 0,
+		static_cast<int> (config.at("timing")) != 0,
+		static_cast<int> (config.at("compression")) != 0,
+		config.at("output_queue"),
+		block_samples,
+		thread_policy(config, "sender"),
+		{
+			config.at("send_buffer"),
+			static_cast<int> (config.at("tcp_nodelay")) != 0,
+			config.at("tcp_keepalive"),
+			config.at("tcp_user_timeout"),
+			static_cast<int> (config.at("zerocopy")) != 0,
+		},
+	};
+}
+
+/**
+ * Read the type of the samples of an Airspy from the configuration: "int" for
+ * IQ samples converted by libairspy, or "real" for the raw samples of the
+ * ADC, converted by rasseiver.
+ *
+ * @param config The configuration.
+ */
+static airspy_sample_type airspy_sample_type_from_config(
+	ConfigMap const &config) {
+	const std::string type {config.at("sample_type").get_value()};
+
+	if (type == "int") {
+		return AIRSPY_SAMPLE_INT16_IQ;
+	} else if (type == "real") {
+		return AIRSPY_SAMPLE_UINT16_REAL;
+	}
+
+	throw std::runtime_error {"Unknown sample type \"" + type + "\""};
+}
+
+/**
+ * Read the tuner of an RSPduo from the configuration: "a" or "b".
+ *
+ * @param config The configuration.
+ */
+static sdrplay_api_TunerSelectT rspduo_tuner_from_config(
+	ConfigMap const &config) {
+	const std::string tuner {config.at("rspduo_tuner").get_value()};
+
+	if (tuner == "a") {
+		return sdrplay_api_Tuner_A;
+	} else if (tuner == "b") {
+		return sdrplay_api_Tuner_B;
+	}
+
+	throw std::runtime_error {"Unknown RSPduo tuner \"" + tuner + "\""};
+}
+
+/**
+ * Read whether an RSPduo is in dual tuner mode from the configuration:
+ * "single" or "dual".
+ *
+ * @param config The configuration.
+ */
+static bool rspduo_dual_from_config(ConfigMap const &config) {
+	const std::string mode {config.at("rspduo_mode").get_value()};
+
+	if (mode == "single") {
+		return false;
+	} else if (mode == "dual") {
+		return true;
+	}
+
+	throw std::runtime_error {"Unknown RSPduo mode \"" + mode + "\""};
+}
+
+/**
+ * Create the filtering engine of a process from the configuration.  The
+ * fastest engine for the filter, the decimation and the precision is chosen
+ * by autotune().  If an output rate is set, a ResamplerEngine is used
+ * instead, on the thread of the device only, as it carries its phase from
+ * an output to the next.
+ *
+ * @param config The configuration.
+ * @param workers The threads helping to filter, if the pool has any.
+ * @param bufsize The size of the buffers of the device, in IQ samples.
+ * @param max_value The max value that the device can sample.
+ */
+template<typename T>
+static std::unique_ptr<FilterEngine<T>> engine_from_config(
+	ConfigMap const &config, WorkerPool &workers, size_t bufsize,
+	int max_value) {
+	Filter filter;
+
+	// Read the filter from the disk, if provided
+	if (config.count("filter") > 0) {
+		filter_read_file(config.at("filter").get_value(), filter);
+	}
+
+	const std::string precision {config.at("precision").get_value()};
+	const unsigned int output_rate {config.at("output_rate")};
+
+	if (output_rate > 0) {
+		auto engine = make_resampler<T>(precision, filter,
+						config.at("sample_rate"),
+						output_rate);
+
+		std::cout << "Resampling to " << output_rate << " Hz with the "
+			  << engine->name() << " engine (" << filter.size()
+			  << " taps)" << std::endl;
+
+		return engine;
+	}
+
+	auto engine = autotune<T>(
+		make_engines<T>(precision, filter, config.at("decimation"),
+				max_value),
+		filter, bufsize, max_value,
+		config.at("autotune_cache").get_value(),
+		"precision=" + precision + " sample_size=" +
+		std::to_string(sizeof(T)));
+
+	std::cout << "Filtering with the " << engine->name() << " engine ("
+		  << filter.size() << " taps)" << std::endl;
+
+	if (workers.size() > 0) {
+		engine = std::make_unique<ParallelEngine<T>> (std::move(engine),
+							      workers);
+	}
+
+	return engine;
+}
+
+/**
+ * Read the NUMA node of the buffers of a pipeline from the configuration.  By
+ * default, it is the node of the first CPU of the device callback, if the
+ * callback is pinned.
+ *
+ * @param config The configuration.
+ * @returns The node, or -1 to let the kernel choose.
+ */
+static int numa_node(ConfigMap const &config) {
+	int node {config.at("numa_node")};
+
+	if (node < 0) {
+		auto cpus = parse_cpu_list(config.at("callback_cpus").get_value());
+
+		if (!cpus.empty()) {
+			node = cpu_node(cpus.front());
+		}
+	}
+
+	return node;
+}
+
+/**
+ * A pipeline for a device producing samples of type T.
+ */
+template<typename T>
+class DevicePipeline: public Pipeline {
+public:
+	/**
+	 * Creates the process of a device, and starts receiving its samples.
+	 *
+	 * @param name The name of the config section.
+	 * @param device The device.
+	 * @param config The configuration of the process, and of the scan if
+	 *   any.
+	 * @param workers The threads helping to filter.
+	 */
+	DevicePipeline(std::string name, std::unique_ptr<Device<T>> device,
+		       ConfigMap const &config, WorkerPool &workers):
+		Pipeline {std::move(name)}, workers {workers},
+		device {std::move(device)},
+		process {this->device->buffer_size(),
+			 engine_from_config<T>(config, workers,
+					       this->device->buffer_size(),
+					       this->device->max_value()),
+			 this->device->max_value(), output_options(config),
+			 thread_policy(config, "callback"), numa_node(config)},
+		receiver {std::make_unique<Receiver<T>> (*this->device,
+							 process)},
+		started {std::chrono::steady_clock::now()},
+		scan_settle {config.at("scan_settle")} {
+		const std::string scan {config.at("scan").get_value()};
+
+		if (!scan.empty()) {
+			scan_steps = parse_scan_list(scan);
+		}
+
+		start_scan();
+	}
+
+	bool is_streaming() override {
+		return device->is_streaming();
+	}
+
+	bool is_stalled(std::chrono::milliseconds timeout) override {
+		const auto last = std::max(
+			started, std::chrono::steady_clock::time_point {
+				std::chrono::nanoseconds {
+					process.last_buffer()}});
+
+		return std::chrono::steady_clock::now() - last > timeout;
+	}
+
+	bool restart() override {
+		// Stopped in the order of their destruction.
+		scanner.reset();
+		receiver.reset();
+
+		if (!device->reopen()) {
+			return false;
+		}
+
+		process.restart();
+		receiver = std::make_unique<Receiver<T>> (*device, process);
+		started = std::chrono::steady_clock::now();
+		start_scan();
+
+		return true;
+	}
+
+	void reload(ConfigMap const &config) override {
+		// Built here, as autotuning takes a while.
+		auto engine = engine_from_config<T>(config, workers,
+						    device->buffer_size(),
+						    device->max_value());
+
+		if (!process.replace_engine(std::move(engine))) {
+			throw std::runtime_error {
+				"The device is not streaming"};
+		}
+	}
+
+private:
+	/**
+	 * Starts the scan, if there is one.
+	 */
+	void start_scan() {
+		if (!scan_steps.empty()) {
+			scanner = std::make_unique<Scanner<T>> (
+				*device, process, scan_steps, scan_settle);
+		}
+	}
+
+	WorkerPool &workers;
+
+	// Declared in this order, so that the scan stops before the device
+	// stops streaming, the device stops streaming before the process is
+	// destroyed, and is closed last.
+	const std::unique_ptr<Device<T>> device;
+	Process<T> process;
+	std::unique_ptr<Receiver<T>> receiver;
+	std::unique_ptr<Scanner<T>> scanner;
+
+	// When the device was last started.
+	std::chrono::steady_clock::time_point started;
+
+	std::vector<ScanStep> scan_steps;
+	const int scan_settle;
+};
+
+/**
+ * Creates a pipeline.
+ *
+ * @param section The config section describing the pipeline.
+ * @param device The device.
+ * @param workers The threads helping to filter.
+ */
+template<typename T>
+static std::unique_ptr<Pipeline> pipeline(ConfigSection const &section,
+					  std::unique_ptr<Device<T>> device,
+					  WorkerPool &workers) {
+	return std::make_unique<DevicePipeline<T>> (
+		section.name, std::move(device), section.config, workers);
+}
+
+std::unique_ptr<Pipeline> make_pipeline(ConfigSection const &section,
+					WorkerPool &workers) {
+	ConfigMap const &config {section.config};
+	ConfigValue const &device {config.at("device")};
+
+	if (device == "airspy") {
+		std::unique_ptr<Airspy> airspy;
+
+		// Determine which airspy to use
+		if (config.count("serial_number") > 0) {
+			airspy = std::make_unique<Airspy> (
+				static_cast<uint64_t> (
+					config.at("serial_number")),
+				static_cast<unsigned int> (
+					config.at("frequency")),
+				static_cast<unsigned int> (
+					config.at("sample_rate")),
+				airspy_sample_type_from_config(config));
+		} else {
+			airspy = std::make_unique<Airspy> (
+				static_cast<unsigned int> (
+					config.at("frequency")),
+				static_cast<unsigned int> (
+					config.at("sample_rate")),
+				airspy_sample_type_from_config(config));
+		}
+
+		airspy->set_packing(static_cast<int> (config.at("packing")) != 0);
+		airspy->set_sync_interval(std::chrono::milliseconds {
+				static_cast<unsigned int> (
+					config.at("sync_check_interval"))});
+
+		return pipeline<int16_t> (section, std::move(airspy), workers);
+	} else if (device == "dummy") {
+		return pipeline<int16_t> (
+			section, std::make_unique<DummyDevice> (
+				static_cast<int> (config.at("count"))),
+			workers);
+	} else if (device == "rspduo") {
+		// Both tuners of an RSPduo in dual tuner mode are used by
+		// two sections with the same serial number, if any.
+		return pipeline<int16_t> (
+			section, std::make_unique<RSPDuo> (
+				config.count("serial_number") > 0 ?
+				config.at("serial_number").get_value() : "",
+				rspduo_tuner_from_config(config),
+				rspduo_dual_from_config(config),
+				static_cast<unsigned int> (
+					config.at("frequency")),
+				static_cast<unsigned int> (
+					config.at("sample_rate")),
+				static_cast<int> (config.at("gain_reduction")),
+				static_cast<int> (config.at("lna_state"))),
+			workers);
+	}
+
+	throw std::runtime_error {"Unknown device type \"" +
+			device.get_value() + "\""};
+}
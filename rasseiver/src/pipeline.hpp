@@ -0,0 +1,97 @@
+#ifndef __ILSIMU_RASSEIVER_PIPELINE_HPP
+# define __ILSIMU_RASSEIVER_PIPELINE_HPP
+
+# include <chrono>
+# include <memory>
+# include <string>
+
+# include "config.hpp"
+# include "worker_pool.hpp"
+
+/**
+ * A device, and the process filtering its samples and sending them to a
+ * server.  Samples are received as long as the pipeline is alive.
+ *
+ * This is independent of the type of the samples of the device, so that
+ * pipelines of different devices can be handled together.
+ */
+class Pipeline {
+public:
+	virtual ~Pipeline() = default;
+
+	Pipeline(Pipeline const &) = delete;
+	Pipeline &operator=(Pipeline const &) = delete;
+
+	/**
+	 * Returns the name of the config section describing the pipeline.
+	 */
+	std::string const &name() const {
+		return section_name;
+	}
+
+	/**
+	 * Checks that the device is still streaming.
+	 */
+	virtual bool is_streaming() = 0;
+
+	/**
+	 * Checks whether the device stalled, ie. whether no buffer was received
+	 * for a while, since it was started or restarted.
+	 *
+	 * @param timeout The longest time without buffers.
+	 */
+	virtual bool is_stalled(std::chrono::milliseconds timeout) = 0;
+
+	/**
+	 * Restarts the device only: the process, the state of its filter and
+	 * the connection to the server are kept.  The scan, if any, starts
+	 * again from its first frequency.
+	 *
+	 * If the device cannot be opened again, a std::runtime_error is
+	 * thrown, and the pipeline is left stopped until it is restarted
+	 * again.
+	 *
+	 * @returns false if the device cannot be reopened.  The pipeline is
+	 *   stopped then too.
+	 */
+	virtual bool restart() = 0;
+
+	/**
+	 * Replaces the filtering engine with one built from a new
+	 * configuration, without stopping the device.  Only the filter, the
+	 * decimation and the precision are reloaded.  The stream is not
+	 * interrupted, and no block is dropped: the new engine starts with
+	 * the next buffer of the device.
+	 *
+	 * If the engine cannot be built or swapped in, a std::runtime_error
+	 * is thrown, and the current engine is kept.
+	 *
+	 * @param config The new configuration of the pipeline.
+	 */
+	virtual void reload(ConfigMap const &config) = 0;
+
+protected:
+	/**
+	 * @param name The name of the config section.
+	 */
+	Pipeline(std::string name): section_name {std::move(name)} {
+	}
+
+private:
+	const std::string section_name;
+};
+
+/**
+ * Opens the device described by a config section, and starts receiving its
+ * samples.  If the device type is unknown, or if the device cannot be opened,
+ * a std::runtime_error is thrown.
+ *
+ * @param section The config section describing the device, its filter and
+ *   the server.
+ * @param workers The threads helping to filter, if the pool has any.  It must
+ *   outlive the pipeline.
+ */
+std::unique_ptr<Pipeline> make_pipeline(ConfigSection const &section,
+					WorkerPool &workers);
+
+#endif  /* __ILSIMU_RASSEIVER_PIPELINE_HPP */
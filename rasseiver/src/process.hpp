@@ -1,12 +1,21 @@
 #ifndef __ILSIMU_RASSEIVER_PROCESS_HPP
 # define __ILSIMU_RASSEIVER_PROCESS_HPP
 
-# include <array>
+# include <algorithm>
+# include <atomic>
+# include <chrono>
+# include <memory>
+# include <stdexcept>
+# include <thread>
 # include <vector>
 
+# include "alloc_guard.hpp"
 # include "circular_buffer.hpp"
-# include "filter.hpp"
-# include "sender.hpp"
+# include "engine.hpp"
+# include "ils_meter.hpp"
+# include "meter.hpp"
+# include "realtime.hpp"
+# include "sender_thread.hpp"
 
 /**
  * Defines a process to apply to an input buffer.
@@ -22,21 +31,63 @@ public:
 	Process() = delete;
 
 	/**
-	 * Creates a new process with a specified size, filter, and decimation
-	 * factor.
+	 * Creates a new process with a specified size, and filtering engine.
 	 *
-	 * @param bufsize The size of the input buffer to create.
-	 * @param filter The filter to create.  This version copies the filter.
-	 * @param step The decimation factor.
+	 * Every buffer used while processing the input is allocated here, so
+	 * that apply() never allocates memory.
+	 *
+	 * If the filter is longer than the input buffer, or if the output is
+	 * split in blocks of a fixed size with the ils format, a
+	 * std::runtime_error is thrown.
+	 *
+	 * @param bufsize The size of the input buffer to create, in IQ samples.
+	 * @param engine The engine filtering and decimating the input.
 	 * @param threshold The max value that the device associated with this
 	 *   process can sample.  Multiplied by 92%, and is used to detect
 	 *   saturation.
+	 * @param options Where and how the output is sent.
+	 * @param callback The CPUs and scheduling of the thread calling
+	 *   apply().  It is applied on the first call, as the thread is
+	 *   usually created by the library of the device.
+	 * @param node The NUMA node of the buffers, or -1.
 	 */
-	Process(size_t bufsize, Filter filter, int step, int threshold,
-		std::string &&host, unsigned int port):
-		buf {bufsize}, output (bufsize), filter {std::move(filter)},
-		pos {0}, step {step}, threshold {(int) (threshold * 0.92)},
-		sender {std::move(host), (uint16_t) port} {
+	Process(size_t bufsize, std::unique_ptr<FilterEngine<T>> engine,
+		int threshold, OutputOptions const &options,
+		ThreadPolicy const &callback, int node):
+		bufsize {bufsize},
+		buf {bufsize * 2, PageAllocator<T> {"input", node}},
+		engine {std::move(engine)}, pos {0},
+		threshold {(int) (threshold * 0.92)},
+		metering {options.metering}, send_timing {options.timing},
+		sample_ns {1e9 / options.input_rate},
+		format {options.format},
+		scale {options.scale},
+		ils {format == SampleFormat::ils ?
+		     std::make_unique<IlsMeter> (options.rate,
+						 options.ils_period) :
+		     nullptr},
+		measured (ils != nullptr ? max_outputs() * 2 * sizeof(float) :
+			  0, PageAllocator<uint8_t> {"measured", node}),
+		records (ils != nullptr ? ils->max_records(max_outputs()) : 0),
+		chunk {options.block_samples},
+		pool {chunk > 0 ? options.queue_size *
+		      ((max_outputs() + chunk - 1) / chunk) : options.queue_size,
+		      ils != nullptr ? records.size() * sizeof(IlsRecord) :
+		      (chunk > 0 ? chunk : max_outputs()) * 2 *
+		      sample_format_size(format), node},
+		sender {pool, options}, callback {callback} {
+		check_engine(*this->engine);
+
+		if (ils != nullptr && chunk > 0) {
+			throw std::runtime_error {
+				"The size of the output blocks cannot be set "
+				"with the ils format"};
+		}
+	}
+
+	~Process() {
+		delete pending.load();
+		delete retired.load();
 	}
 
 	// No need for these
@@ -46,34 +97,535 @@ public:
 	/**
 	 * Apply the process to the input buffer.
 	 *
+	 * The output is handed to the sender thread, so this never waits for
+	 * the network.  If the sender thread is late and no output block is
+	 * free, the output of this buffer is dropped.
+	 *
+	 * This is called from the device callback, so it must not block nor
+	 * allocate memory.
+	 *
 	 * @param input The raw input data from the buffer.  It is expected to
 	 *   have interleaved I and Q values.
 	 * @param count The size of the buffer.
+	 * @param dropped The amount of IQ samples dropped by the device
+	 *   before this buffer.
+	 */
+	void apply(T *input, size_t count, uint64_t dropped = 0) {
+		apply_buffer(input, count, dropped, false);
+	}
+
+	/**
+	 * Returns where a device may write its next buffer in place, instead
+	 * of handing it to apply(): `bufsize' interleaved IQ samples.  It is
+	 * valid until the next call to apply() or apply_in_place().
 	 */
-	void apply(T *input, size_t count) {
-		output.clear();
+	T *input_buffer() {
+		return buf.spare();
+	}
 
-		buf.switch_buffer(input, count);
+	/**
+	 * Like apply(), for a buffer written in input_buffer(), which saves a
+	 * copy.
+	 *
+	 * @param count The amount of values written, I and Q included.
+	 * @param dropped The amount of IQ samples dropped by the device
+	 *   before this buffer.
+	 */
+	void apply_in_place(size_t count, uint64_t dropped = 0) {
+		apply_buffer(buf.spare(), count, dropped, true);
+	}
 
-		bool saturation {filter_buffer(buf, filter, output, pos, step,
-					       threshold)};
-		pos %= buf.size();
+	/**
+	 * Returns the amount of IQ samples dropped by the device since it
+	 * started streaming, as reported to apply().
+	 */
+	uint64_t dropped_samples() const {
+		return device_dropped.load(std::memory_order_relaxed);
+	}
+
+	/**
+	 * Returns when the last buffer was received, in nanoseconds of the
+	 * steady clock, or 0 if none was.  The supervisor of the device uses it
+	 * to detect stalls.
+	 */
+	int64_t last_buffer() const {
+		return heartbeat.load(std::memory_order_relaxed);
+	}
+
+	/**
+	 * Prepares the process for the restart of the device.  The partial
+	 * output block is sent as it is, and the history of the filter is
+	 * cleared, as the samples received before the restart are not
+	 * contiguous with the next ones.  The timing of the blocks carries on.
+	 *
+	 * This must be called while the device is not receiving data.
+	 */
+	void restart() {
+		if (current != nullptr) {
+			submit(current, current_stats);
+			current = nullptr;
+		}
+
+		buf.clear();
+		pos = 0;
+
+		// The callback may run on a new thread.
+		callback_configured = false;
+	}
+
+	/**
+	 * Announces that the device is about to be tuned to another frequency.
+	 * The buffers received until end_retune() is called are discarded.
+	 */
+	void begin_retune() {
+		retune_start.store(now());
+		retuning.store(true, std::memory_order_release);
+	}
+
+	/**
+	 * Announces that the device has been tuned to another frequency.
+	 *
+	 * The next `settle' buffers are discarded, as the tuner may not be
+	 * stable yet, and some of them may have been sampled before the
+	 * frequency changed.  Then the history of the filter is cleared, and
+	 * the blocks are tagged with the new frequency.
+	 *
+	 * @param frequency The new frequency, in Hz.
+	 * @param settle The amount of buffers to discard.
+	 */
+	void end_retune(uint32_t frequency, int settle) {
+		tuned_frequency.store(frequency, std::memory_order_relaxed);
+		settle_buffers.store(settle, std::memory_order_relaxed);
+		tune_generation.fetch_add(1, std::memory_order_release);
+		retuning.store(false, std::memory_order_release);
+	}
+
+	/**
+	 * Returns the time between the last call to begin_retune() and the
+	 * first block of the new frequency handed to the sender thread, in
+	 * nanoseconds.
+	 *
+	 * @returns The latency, or -1 if no block of the new frequency has
+	 *   been sent since the last call.
+	 */
+	int64_t retune_latency() {
+		return latency.exchange(-1);
+	}
+
+	/**
+	 * Replaces the filtering engine, without interrupting the stream.
+	 *
+	 * The new engine is handed to apply(), which swaps it in before the
+	 * next buffer, and the old one is deleted here, so neither is built
+	 * nor deleted in the device callback.  This must not be called from
+	 * several threads at the same time.
+	 *
+	 * If the filter of the new engine is too long, or if its decimation
+	 * factor is lower than the initial one (the output blocks would be
+	 * too small), a std::runtime_error is thrown.
+	 *
+	 * @param next The new engine.
+	 * @returns false if the engine could not be swapped in, because the
+	 *   device is not streaming.
+	 */
+	bool replace_engine(std::unique_ptr<FilterEngine<T>> next) {
+		check_engine(*next);
+
+		if (ils != nullptr && next->step() != engine->step()) {
+			throw std::runtime_error {
+				"The decimation cannot be changed with the ils "
+				"format without a restart"};
+		}
+
+		if (ils == nullptr && chunk == 0 &&
+		    (bufsize / next->step() + 1) * 2 *
+		    sample_format_size(format) > pool.capacity()) {
+			throw std::runtime_error {
+				"The decimation cannot be lowered without a "
+				"restart"};
+		}
 
-		if (sender.send_vector<T>(output, saturation) <= 0) {
-			sender.reconnect();
+		pending.store(next.release());
+
+		// Wait for a few buffers.
+		for (int i = 0; i < 1000 && retired.load() == nullptr; i++) {
+			std::this_thread::sleep_for(
+				std::chrono::milliseconds {1});
 		}
+
+		if (retired.load() == nullptr) {
+			std::unique_ptr<FilterEngine<T>> unused {
+				pending.exchange(nullptr)};
+
+			if (unused != nullptr) {
+				return false;
+			}
+
+			// apply() took it in the meantime.
+			while (retired.load() == nullptr) {
+				std::this_thread::yield();
+			}
+		}
+
+		delete retired.exchange(nullptr);
+
+		return true;
 	}
 
 private:
+	/**
+	 * See apply() and apply_in_place().
+	 *
+	 * @param in_place Whether the input was written in the spare buffer.
+	 */
+	void apply_buffer(T *input, size_t count, uint64_t dropped,
+			  bool in_place) {
+		if (!callback_configured) {
+			apply_thread_policy(callback, "callback");
+			callback_configured = true;
+		}
+
+		AllocGuard guard;
+		Metering stats;
+
+		// Every buffer counts in the position of the samples, even if
+		// it is discarded.
+		arrival.monotonic = now();
+		arrival.realtime = std::chrono::duration_cast<
+			std::chrono::nanoseconds> (
+				std::chrono::system_clock::now()
+				.time_since_epoch()).count();
+		arrival.dropped += dropped;
+		arrival.sample = next_sample + dropped;
+		next_sample = arrival.sample + count / 2;
+		heartbeat.store(arrival.monotonic, std::memory_order_relaxed);
+
+		if (dropped > 0) {
+			device_dropped.store(arrival.dropped,
+					     std::memory_order_relaxed);
+		}
+
+		// Between two buffers, so the position of the next output and
+		// the previous buffer carry over to the new engine.
+		if (FilterEngine<T> *next = pending.exchange(nullptr)) {
+			retired.store(engine.release());
+			engine.reset(next);
+		}
+
+		// The buffers received while the device is being tuned mix
+		// two frequencies.
+		if (retuning.load(std::memory_order_acquire)) {
+			return;
+		}
+
+		const uint64_t generation {
+			tune_generation.load(std::memory_order_acquire)};
+
+		if (generation != tuned_generation) {
+			// The partial block of the previous frequency is sent
+			// as it is.
+			if (current != nullptr) {
+				submit(current, current_stats);
+				current = nullptr;
+			}
+
+			// The samples of the previous frequency must not be
+			// used as the history of the filter.
+			tuned_generation = generation;
+			frequency = tuned_frequency.load(std::memory_order_relaxed);
+			settle = settle_buffers.load(std::memory_order_relaxed);
+			measuring = true;
+			buf.clear();
+			pos = 0;
+		}
+
+		if (settle > 0) {
+			settle--;
+			return;
+		}
+
+		// Saturation happens on the raw input, so it is measured
+		// before filtering.
+		meter_buffer(input, count, threshold, stats);
+
+		if (in_place) {
+			buf.switch_spare(count);
+		} else {
+			buf.switch_buffer(input, count);
+		}
+
+		if (chunk > 0) {
+			filter_chunks(stats);
+			return;
+		}
+
+		Block *block {ils == nullptr ? filter() : measure()};
+
+		if (block != nullptr) {
+			submit(block, stats);
+		}
+	}
+
+	/**
+	 * Filters the current buffer into an output block.
+	 *
+	 * @returns The block, or nullptr if none is free.
+	 */
+	Block *filter() {
+		const Timing timing {stamp()};
+		Block *block {pool.acquire()};
+
+		if (block == nullptr) {
+			engine->skip(buf, pos);
+			pos %= buf.size();
+			return nullptr;
+		}
+
+		block->timing = timing;
+		SampleWriter writer {format, scale, block->data.data()};
+
+		engine->apply(buf, writer, pos);
+		writer.flush();
+		pos %= buf.size();
+
+		block->size = writer.size();
+
+		return block;
+	}
+
+	/**
+	 * Filters the current buffer into blocks of `chunk' outputs, each
+	 * handed to the sender thread as soon as it is full, before the rest
+	 * of the buffer is filtered.  The last block is completed by the next
+	 * buffers.
+	 *
+	 * @param stats The statistics of the current buffer.
+	 */
+	void filter_chunks(Metering const &stats) {
+		const size_t stride {(size_t) engine->step() * 2};
+		const size_t sample_size {2 * sample_format_size(format)};
+
+		if (current != nullptr) {
+			merge_metering(current_stats, stats, current_buffers++);
+		}
+
+		while (pos < buf.size()) {
+			if (current == nullptr) {
+				const Timing timing {stamp()};
+
+				current = pool.acquire();
+
+				if (current == nullptr) {
+					engine->skip(buf, pos);
+					break;
+				}
+
+				current->size = 0;
+				current->timing = timing;
+				current_stats = stats;
+				current_buffers = 1;
+			}
+
+			// At most the missing outputs, as the outputs of a
+			// resampler are at least `stride' apart.
+			const size_t missing {chunk - current->size / sample_size};
+			SampleWriter writer {format, scale,
+					     current->data.data() + current->size};
+
+			engine->apply(buf, writer, pos,
+				      std::min(pos + missing * stride,
+					       buf.size()));
+			writer.flush();
+			current->size += writer.size();
+
+			if (current->size == chunk * sample_size) {
+				submit(current, current_stats);
+				current = nullptr;
+			}
+		}
+
+		pos %= buf.size();
+	}
+
+	/**
+	 * Fills the informations of a block, and hands it to the sender
+	 * thread.
+	 *
+	 * @param block The block.
+	 * @param stats The statistics of the raw input of the block.
+	 */
+	void submit(Block *block, Metering const &stats) {
+		block->format = format;
+		block->saturation = stats.clipped > 0;
+		block->compressed = false;
+		block->metering = stats;
+		block->has_metering = metering;
+		block->frequency = frequency;
+		block->has_frequency = tuned_generation > 0;
+		block->has_timing = send_timing;
+
+		pool.submit(block);
+
+		if (measuring) {
+			latency.store(now() - retune_start.load());
+			measuring = false;
+		}
+	}
+
+	/**
+	 * Filters the current buffer, and measures the ILS signal.  The
+	 * records of the windows ending in this buffer are written to an
+	 * output block.
+	 *
+	 * @returns The block, or nullptr if no window ended or if no block is
+	 *   free.
+	 */
+	Block *measure() {
+		Timing timing {arrival};
+		SampleWriter writer {SampleFormat::float32, scale,
+				     measured.data()};
+
+		timing.sample += pos / 2;
+		capture_time(timing);
+
+		engine->apply(buf, writer, pos);
+		writer.flush();
+		pos %= buf.size();
+
+		const size_t n {ils->measure(
+				reinterpret_cast<float const *> (
+					measured.data()),
+				writer.size() / sizeof(float) / 2,
+				arrival.realtime, records.data())};
+
+		if (n == 0) {
+			return nullptr;
+		}
+
+		timing.sequence = sequence++;
+
+		Block *block {pool.acquire()};
+
+		if (block != nullptr) {
+			std::copy_n(records.data(), n,
+				    reinterpret_cast<IlsRecord *> (
+					    block->data.data()));
+			block->size = n * sizeof(IlsRecord);
+			block->timing = timing;
+		}
+
+		return block;
+	}
+
+	/**
+	 * Returns the timing of a block starting with the next output, and
+	 * numbers the block.
+	 */
+	Timing stamp() {
+		Timing timing {arrival};
+
+		timing.sequence = sequence++;
+		timing.sample += pos / 2;
+		capture_time(timing);
+
+		return timing;
+	}
+
+	/**
+	 * Moves the timestamps of a block from the arrival of the current
+	 * buffer back to the capture of its first input sample, as the buffer
+	 * arrives once its last sample is captured.
+	 */
+	void capture_time(Timing &timing) const {
+		const int64_t age {static_cast<int64_t> (
+				(next_sample - timing.sample) * sample_ns)};
+
+		timing.realtime -= age;
+		timing.monotonic -= age;
+	}
+
+	/**
+	 * Returns the maximum amount of outputs of a buffer.
+	 */
+	size_t max_outputs() const {
+		return bufsize / engine->step() + 1;
+	}
+
+	static int64_t now() {
+		return std::chrono::duration_cast<std::chrono::nanoseconds> (
+			std::chrono::steady_clock::now().time_since_epoch())
+			.count();
+	}
+
+	/**
+	 * Checks that an engine can filter the buffers of the device: the
+	 * previous buffer must hold the history of the filter.
+	 */
+	void check_engine(FilterEngine<T> const &engine) const {
+		if (engine.length() > bufsize + 1) {
+			throw std::runtime_error {
+				"The filter is longer than the device buffer"};
+		}
+	}
+
+	const size_t bufsize;
 	CircularBuffer<T> buf;
-	std::vector<T> output;
-	const Filter filter;
+	std::unique_ptr<FilterEngine<T>> engine;
+
+	// The engine to swap in, and the engine swapped out, exchanged with
+	// replace_engine().
+	std::atomic<FilterEngine<T> *> pending {nullptr};
+	std::atomic<FilterEngine<T> *> retired {nullptr};
 
 	size_t pos;
-	const int step;
 	const int threshold;
+	const bool metering;
+	const bool send_timing;
+	const double sample_ns; // The period of the input, in nanoseconds
+	const SampleFormat format;
+	const double scale;
+
+	// With the ils format, the outputs are measured rather than sent.
+	const std::unique_ptr<IlsMeter> ils;
+	PageVector<uint8_t> measured;
+	std::vector<IlsRecord> records;
+
+	// The amount of outputs of a block, or 0 for one block for each
+	// buffer.  The block being filled, and the statistics of its buffers,
+	// are kept from a buffer to the next.
+	const size_t chunk;
+	Block *current {nullptr};
+	Metering current_stats {};
+	size_t current_buffers {0};
+
+	BlockPool pool;
+	SenderThread sender;
+
+	const ThreadPolicy callback;
+	bool callback_configured {false};
+
+	// Set by the thread tuning the device, see begin_retune() and
+	// end_retune().
+	std::atomic<bool> retuning {false};
+	std::atomic<uint64_t> tune_generation {0};
+	std::atomic<uint32_t> tuned_frequency {0};
+	std::atomic<int> settle_buffers {0};
+	std::atomic<int64_t> retune_start {0};
+	std::atomic<int64_t> latency {-1};
+
+	// When the current buffer was received, and the position of its first
+	// sample in the stream.
+	Timing arrival {};
+	uint64_t next_sample {0};
+	uint64_t sequence {0};
+	std::atomic<uint64_t> device_dropped {0};
+	std::atomic<int64_t> heartbeat {0};
 
-	Sender sender;
+	// The state of the current frequency, only used by apply().
+	uint64_t tuned_generation {0};
+	uint32_t frequency {0};
+	int settle {0};
+	bool measuring {false};
 };
 
 #endif  /* __ILSIMU_RASSEIVER_PROCESS_HPP */
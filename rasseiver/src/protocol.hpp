@@ -0,0 +1,81 @@
+#ifndef __ILSIMU_RASSEIVER_PROTOCOL_HPP
+# define __ILSIMU_RASSEIVER_PROTOCOL_HPP
+
+# include <cstddef>
+# include <cstdint>
+
+/**
+ * The framing of the stream sent to a server, shared by the sender and the
+ * servers of this tree.  Everything is sent in little-endian.
+ *
+ * Each block starts with a header of `protocol_header_size' bytes:
+ *   * the size of the data, in bytes, not counting the header and the
+ *     records following it (64 bits);
+ *   * flags (8 bits):
+ *       * First bit (LSB): whether the data is saturated or not.
+ *       * Second bit: whether a Metering structure (12 bytes) follows the
+ *                     header, before the data.
+ *       * Third to fifth bits: the format of the samples, see SampleFormat.
+ *       * Sixth bit: whether the data is compressed (see codec.hpp).  In
+ *                    this case, the size is the one of the compressed data.
+ *       * Seventh bit: whether the frequency of the samples, in Hz, follows
+ *                      the header (and the Metering structure if any) as a
+ *                      32 bits integer.
+ *       * Eighth bit: whether a Timing record follows the previous
+ *                     records (see block.hpp).
+ *
+ * The Timing record starts with its size (16 bits) and its version (16 bits).
+ * Later versions may only append fields, so readers skip the record with its
+ * size, and read the fields they know.  The first version is
+ * `protocol_timing_size' bytes long.
+ */
+
+constexpr size_t protocol_header_size {9};
+
+constexpr uint8_t protocol_flag_saturation {1 << 0};
+constexpr uint8_t protocol_flag_metering {1 << 1};
+constexpr int protocol_format_shift {2};
+constexpr uint8_t protocol_format_mask {7 << protocol_format_shift};
+constexpr uint8_t protocol_flag_compressed {1 << 5};
+constexpr uint8_t protocol_flag_frequency {1 << 6};
+constexpr uint8_t protocol_flag_timing {1 << 7};
+
+/**
+ * The flags which are not reserved.
+ */
+constexpr uint8_t protocol_known_flags {
+	protocol_flag_saturation | protocol_flag_metering |
+	protocol_format_mask | protocol_flag_compressed |
+	protocol_flag_frequency | protocol_flag_timing};
+
+constexpr size_t protocol_metering_size {12};
+constexpr size_t protocol_frequency_size {4};
+constexpr size_t protocol_timing_size {48};
+constexpr uint16_t protocol_timing_version {1};
+
+/**
+ * Returns the size of the records following a header, before the data.
+ *
+ * The size of the Timing record is read from the records, if they are given.
+ * Otherwise, the size of its first version is assumed, so that the records can
+ * be received up to its size first.
+ *
+ * @param flags The flags of the header.
+ * @param records The records, or nullptr.
+ */
+inline size_t protocol_records_size(uint8_t flags,
+				    uint8_t const *records = nullptr) {
+	const size_t fixed {
+		(flags & protocol_flag_metering ? protocol_metering_size : 0) +
+		(flags & protocol_flag_frequency ? protocol_frequency_size : 0)};
+
+	if (!(flags & protocol_flag_timing)) {
+		return fixed;
+	} else if (records == nullptr) {
+		return fixed + protocol_timing_size;
+	}
+
+	return fixed + (records[fixed] | records[fixed + 1] << 8);
+}
+
+#endif  /* __ILSIMU_RASSEIVER_PROTOCOL_HPP */
@@ -0,0 +1,114 @@
+#include <iostream>
+#include <sstream>
+#include <stdexcept>
+
+#include <cerrno>
+#include <cstring>
+
+#include <pthread.h>
+#include <sched.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include "log.hpp"
+#include "realtime.hpp"
+
+/**
+ * The amount of stack prefaulted by apply_thread_policy().
+ */
+static constexpr size_t stack_prefault_size {256 * 1024};
+
+ThreadPolicy thread_policy(ConfigMap const &config, std::string const &prefix) {
+	return {
+		parse_cpu_list(config.at(prefix + "_cpus").get_value()),
+		config.at(prefix + "_priority"),
+	};
+}
+
+/**
+ * Touches the pages of the stack which the calling thread may use later.
+ */
+static void prefault_stack() {
+	volatile unsigned char stack[stack_prefault_size];
+	const size_t page {static_cast<size_t> (sysconf(_SC_PAGESIZE))};
+
+	for (size_t i = 0; i < sizeof(stack); i += page) {
+		stack[i] = 0;
+	}
+}
+
+void apply_thread_policy(ThreadPolicy const &policy, char const *name) {
+	int ret;
+
+	if (!policy.cpus.empty()) {
+		cpu_set_t set;
+
+		CPU_ZERO(&set);
+
+		for (int cpu: policy.cpus) {
+			CPU_SET(cpu, &set);
+		}
+
+		if ((ret = pthread_setaffinity_np(pthread_self(), sizeof(set),
+						  &set))) {
+			log_message(LogLevel::warning,
+				    "Could not set the CPUs of the %s thread: %s",
+				    name, std::strerror(ret));
+		}
+	}
+
+	if (policy.priority > 0) {
+		sched_param param {};
+
+		param.sched_priority = policy.priority;
+
+		if ((ret = pthread_setschedparam(pthread_self(), SCHED_FIFO,
+						 &param))) {
+			log_message(LogLevel::warning,
+				    "Could not set the real-time priority of the "
+				    "%s thread: %s", name, std::strerror(ret));
+		}
+	}
+
+	prefault_stack();
+}
+
+void lock_memory() {
+	if (mlockall(MCL_CURRENT | MCL_FUTURE)) {
+		std::cerr << "Could not lock the memory: "
+			  << std::strerror(errno) << std::endl;
+	}
+}
+
+std::vector<int> parse_cpu_list(std::string const &list) {
+	std::vector<int> cpus;
+	std::istringstream stream {list};
+	std::string item;
+
+	while (std::getline(stream, item, ',')) {
+		int first, last;
+		char dash;
+		std::istringstream range {item};
+
+		// The CPUs must fit in a cpu_set_t.
+		if (!(range >> first) || first < 0 || first >= CPU_SETSIZE) {
+			throw std::runtime_error {"Bad CPU list \"" + list + "\""};
+		}
+
+		if (range >> dash) {
+			if (dash != '-' || !(range >> last) || last < first ||
+			    last >= CPU_SETSIZE) {
+				throw std::runtime_error {
+					"Bad CPU list \"" + list + "\""};
+			}
+		} else {
+			last = first;
+		}
+
+		for (int cpu = first; cpu <= last; cpu++) {
+			cpus.push_back(cpu);
+		}
+	}
+
+	return cpus;
+}
@@ -0,0 +1,67 @@
+#ifndef __ILSIMU_RASSEIVER_REALTIME_HPP
+# define __ILSIMU_RASSEIVER_REALTIME_HPP
+
+# include <string>
+# include <vector>
+
+# include "config.hpp"
+
+/**
+ * The CPUs and the scheduling of a thread.
+ *
+ * All real-time settings fail soft: if the process lacks the privileges
+ * (CAP_SYS_NICE, RLIMIT_RTPRIO, RLIMIT_MEMLOCK...), a warning is printed and
+ * the thread keeps its default settings.
+ */
+struct ThreadPolicy {
+	/**
+	 * The CPUs on which the thread may run.  If it is empty, the affinity
+	 * of the thread is not changed.
+	 */
+	std::vector<int> cpus;
+
+	/**
+	 * The SCHED_FIFO priority of the thread, between 1 and 99.  If it is
+	 * 0, the thread keeps the default scheduling policy.
+	 */
+	int priority;
+};
+
+/**
+ * Reads the policy of a kind of threads from the configuration, ie. the
+ * parameters `<prefix>_cpus' and `<prefix>_priority'.
+ *
+ * @param config The configuration.
+ * @param prefix The kind of threads, eg. "sender".
+ */
+ThreadPolicy thread_policy(ConfigMap const &config, std::string const &prefix);
+
+/**
+ * Applies a policy to the calling thread, and prefaults its stack, so that
+ * it does not page fault later on.
+ *
+ * @param policy The policy to apply.
+ * @param name The name of the thread, used in warnings.
+ */
+void apply_thread_policy(ThreadPolicy const &policy, char const *name);
+
+/**
+ * Locks all the current and future memory of the process in RAM with
+ * mlockall(), so that buffers allocated afterwards are resident as soon as
+ * they are allocated, and never paged out.
+ *
+ * The buffers of the real-time paths are all allocated and zeroed when the
+ * pipelines are created, so they never page fault afterwards.
+ */
+void lock_memory();
+
+/**
+ * Parses a list of CPUs, as found in the config file: CPU numbers and ranges
+ * ("0-3") separated by commas.  If the list is malformed, or if a CPU is negative
+ * or not lower than CPU_SETSIZE, a std::runtime_error is thrown.
+ *
+ * @param list The list to parse.  It may be empty.
+ */
+std::vector<int> parse_cpu_list(std::string const &list);
+
+#endif  /* __ILSIMU_RASSEIVER_REALTIME_HPP */
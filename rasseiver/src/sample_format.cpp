@@ -0,0 +1,167 @@
+#include <algorithm>
+#include <stdexcept>
+
+#include <cstring>
+
+#include "sample_format.hpp"
+
+SampleFormat sample_format_from_string(std::string const &name) {
+	if (name == "int16") {
+		return SampleFormat::int16;
+	} else if (name == "int8") {
+		return SampleFormat::int8;
+	} else if (name == "float16") {
+		return SampleFormat::float16;
+	} else if (name == "float32") {
+		return SampleFormat::float32;
+	} else if (name == "ils") {
+		return SampleFormat::ils;
+	}
+
+	throw std::runtime_error {"Unknown output format \"" + name + "\""};
+}
+
+size_t sample_format_size(SampleFormat format) {
+	switch (format) {
+	case SampleFormat::int8:
+		return 1;
+	case SampleFormat::int16:
+	case SampleFormat::float16:
+		return 2;
+	case SampleFormat::float32:
+	case SampleFormat::ils:
+		return 4;
+	}
+
+	return 0;
+}
+
+/**
+ * Rounds a value half away from zero (like std::round()), and saturates it to
+ * [lo; hi].
+ *
+ * std::round() prevents the vectorisation of the conversion loops, so it is
+ * done here with a truncation and a comparison.  The result is the same as
+ * std::round() for every value in range.
+ *
+ * @param x The value to round.
+ * @param lo The lowest value of the output type.
+ * @param hi The highest value of the output type.
+ */
+template<typename I>
+static inline I round_saturate(double x, double lo, double hi) {
+	x = std::min(std::max(x, lo), hi);
+
+	int32_t t {static_cast<int32_t> (x)};
+	double frac {x - t};
+
+	t += (frac >= 0.5) - (frac <= -0.5);
+
+	return static_cast<I> (t);
+}
+
+/**
+ * Converts a single precision floating number to a half precision floating
+ * number, rounding to the nearest even value.
+ *
+ * All cases (overflow, normal and subnormal numbers) are computed and the
+ * right one is selected at the end, so the function can be vectorised.  This
+ * is derived from Fabian Giesen's float_to_half_fast3_rtne().
+ *
+ * @param value The value to convert.
+ * @returns The binary representation of the half precision value.
+ */
+static inline uint16_t float_to_half(float value) {
+	constexpr uint32_t f32_infinity {255u << 23};
+	constexpr uint32_t f16_max {(127u + 16) << 23};
+	constexpr uint32_t f16_min_normal {113u << 23};
+	constexpr uint32_t denorm_magic {((127u - 15) + (23 - 10) + 1) << 23};
+	uint32_t f, sign;
+	float magic, denorm;
+	uint32_t denorm_bits;
+
+	std::memcpy(&f, &value, sizeof(f));
+	std::memcpy(&magic, &denorm_magic, sizeof(magic));
+
+	sign = f & 0x80000000u;
+	f ^= sign;
+
+	// Overflow: infinity, or NaN if the input was NaN
+	uint32_t overflow {f > f32_infinity ? 0x7e00u : 0x7c00u};
+
+	// Subnormal: let the FPU do the rounding by adding a magic number
+	std::memcpy(&denorm, &f, sizeof(denorm));
+	denorm += magic;
+	std::memcpy(&denorm_bits, &denorm, sizeof(denorm_bits));
+	denorm_bits -= denorm_magic;
+
+	// Normal: rebias the exponent, and round to nearest even
+	uint32_t normal {(f + (static_cast<uint32_t> (15 - 127) << 23) + 0xfff +
+			  ((f >> 13) & 1)) >> 13};
+
+	uint32_t half {f >= f16_max ? overflow :
+			f < f16_min_normal ? denorm_bits : normal};
+
+	return static_cast<uint16_t> (half | (sign >> 16));
+}
+
+void SampleWriter::flush() {
+	const size_t n {count};
+
+	switch (format) {
+	case SampleFormat::int16: {
+		int16_t converted[std::tuple_size<decltype(tile)>::value];
+
+#pragma omp simd
+		for (size_t k = 0; k < n; k++) {
+			converted[k] = round_saturate<int16_t> (tile[k] * scale,
+								-32768, 32767);
+		}
+
+		std::memcpy(output + written, converted, n * sizeof(int16_t));
+		written += n * sizeof(int16_t);
+		break;
+	}
+	case SampleFormat::int8: {
+		int8_t converted[std::tuple_size<decltype(tile)>::value];
+
+#pragma omp simd
+		for (size_t k = 0; k < n; k++) {
+			converted[k] = round_saturate<int8_t> (tile[k] * scale,
+							       -128, 127);
+		}
+
+		std::memcpy(output + written, converted, n * sizeof(int8_t));
+		written += n * sizeof(int8_t);
+		break;
+	}
+	case SampleFormat::float16: {
+		uint16_t converted[std::tuple_size<decltype(tile)>::value];
+
+#pragma omp simd
+		for (size_t k = 0; k < n; k++) {
+			converted[k] = float_to_half(
+				static_cast<float> (tile[k] * scale));
+		}
+
+		std::memcpy(output + written, converted, n * sizeof(uint16_t));
+		written += n * sizeof(uint16_t);
+		break;
+	}
+	case SampleFormat::float32:
+	case SampleFormat::ils: {
+		float converted[std::tuple_size<decltype(tile)>::value];
+
+#pragma omp simd
+		for (size_t k = 0; k < n; k++) {
+			converted[k] = static_cast<float> (tile[k] * scale);
+		}
+
+		std::memcpy(output + written, converted, n * sizeof(float));
+		written += n * sizeof(float);
+		break;
+	}
+	}
+
+	count = 0;
+}
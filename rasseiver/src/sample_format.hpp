@@ -0,0 +1,136 @@
+#ifndef __ILSIMU_RASSEIVER_SAMPLE_FORMAT_HPP
+# define __ILSIMU_RASSEIVER_SAMPLE_FORMAT_HPP
+
+# include <array>
+# include <string>
+
+# include <cstddef>
+# include <cstdint>
+
+/**
+ * The formats in which filtered samples can be sent.  The value of each format
+ * is the one sent in the header flags (see Sender::Header), so they must not
+ * be changed.
+ */
+enum class SampleFormat: uint8_t {
+	int16 = 0,   // Rounded and saturated 16 bits integers (default)
+	int8 = 1,    // Rounded and saturated 8 bits integers
+	float16 = 2, // IEEE 754 half precision floating numbers
+	float32 = 3, // IEEE 754 single precision floating numbers
+	ils = 4,     // IlsRecord structures instead of samples (ils_meter.hpp)
+};
+
+/**
+ * Converts a format name, as found in the config file, to a SampleFormat.  If
+ * the name is unknown, a std::runtime_error is thrown.
+ *
+ * @param name The name of the format ("int16", "int8", "float16", "float32"
+ *   or "ils").
+ */
+SampleFormat sample_format_from_string(std::string const &name);
+
+/**
+ * Returns the size of a single value (I or Q) in the specified format, in
+ * bytes.  With the ils format, it is the size of the single precision values
+ * which are measured.
+ *
+ * @param format The format.
+ */
+size_t sample_format_size(SampleFormat format);
+
+/**
+ * Writes filtered IQ values to an output buffer in a specific format.
+ *
+ * Values are first stored in a small tile which stays in the L1 cache, and
+ * are converted to the output format when it is full, or when flush() is
+ * called.  The conversion loops have no branch, so they are vectorised by the
+ * compiler, and the values are never stored in an intermediate buffer in main
+ * memory.
+ *
+ * This class does not perform any kind of bound checking when writing to the
+ * output buffer.  Make sure it is big enough.
+ */
+class SampleWriter {
+public:
+	SampleWriter() = delete;
+
+	/**
+	 * Creates a writer.
+	 *
+	 * @param format The output format.
+	 * @param scale The factor by which each value is multiplied before
+	 *   being converted.
+	 * @param output The buffer where converted values are written.
+	 */
+	SampleWriter(SampleFormat format, double scale, uint8_t *output):
+		format {format}, scale {scale}, output {output} {
+	}
+
+	/**
+	 * Creates a writer for a slice of the output of another writer, so
+	 * that several threads can write disjoint parts of the same buffer.
+	 * The tile of `parent' must be empty (see flush()).
+	 *
+	 * @param parent The writer whose output is sliced.
+	 * @param index The amount of IQ samples between the current position
+	 *   of `parent' and the beginning of the slice.
+	 */
+	SampleWriter(SampleWriter const &parent, size_t index):
+		format {parent.format}, scale {parent.scale},
+		output {parent.output + parent.written +
+			index * 2 * sample_format_size(parent.format)} {
+	}
+
+	SampleWriter(SampleWriter const &) = delete;
+	SampleWriter &operator=(SampleWriter const &) = delete;
+
+	/**
+	 * Adds an IQ sample to the output.
+	 *
+	 * @param i The I value.
+	 * @param q The Q value.
+	 */
+	void put(double i, double q) {
+		tile[count++] = i;
+		tile[count++] = q;
+
+		if (count == tile.size()) {
+			flush();
+		}
+	}
+
+	/**
+	 * Converts the values remaining in the tile and writes them to the
+	 * output buffer.  This must be called once all values have been put.
+	 */
+	void flush();
+
+	/**
+	 * Accounts for IQ samples written to the output buffer by other
+	 * writers, created with the slicing constructor.  The tile must be
+	 * empty.
+	 *
+	 * @param count The amount of IQ samples written.
+	 */
+	void skip(size_t count) {
+		written += count * 2 * sample_format_size(format);
+	}
+
+	/**
+	 * Returns the amount of bytes written to the output buffer so far.
+	 */
+	size_t size() const {
+		return written;
+	}
+
+private:
+	const SampleFormat format;
+	const double scale;
+	uint8_t *const output;
+
+	size_t written {0};
+	size_t count {0};
+	std::array<double, 256> tile;
+};
+
+#endif  /* __ILSIMU_RASSEIVER_SAMPLE_FORMAT_HPP */
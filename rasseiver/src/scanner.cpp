@@ -0,0 +1,26 @@
+#include "scanner.hpp"
+
+#include <sstream>
+
+std::vector<ScanStep> parse_scan_list(std::string const &list) {
+	std::vector<ScanStep> steps;
+	std::istringstream stream {list};
+	std::string item;
+
+	while (std::getline(stream, item, ',')) {
+		uint32_t frequency;
+		long dwell;
+		char colon;
+		std::istringstream step {item};
+
+		if (!(step >> frequency >> colon >> dwell) || colon != ':' ||
+		    dwell <= 0 || !(step >> std::ws).eof()) {
+			throw std::runtime_error {
+				"Bad scan list \"" + list + "\""};
+		}
+
+		steps.push_back({frequency, std::chrono::milliseconds {dwell}});
+	}
+
+	return steps;
+}
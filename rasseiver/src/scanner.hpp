@@ -0,0 +1,162 @@
+#ifndef __ILSIMU_RASSEIVER_SCANNER_HPP
+# define __ILSIMU_RASSEIVER_SCANNER_HPP
+
+# include <algorithm>
+# include <chrono>
+# include <condition_variable>
+# include <iostream>
+# include <mutex>
+# include <stdexcept>
+# include <string>
+# include <thread>
+# include <vector>
+
+# include "device.hpp"
+# include "log.hpp"
+
+/**
+ * A frequency of a scan, and how long the device stays on it.
+ */
+struct ScanStep {
+	uint32_t frequency;
+	std::chrono::milliseconds dwell;
+};
+
+/**
+ * Parses a scan schedule.  If it is malformed, a std::runtime_error is
+ * thrown.
+ *
+ * @param list A comma-separated list of frequencies in Hz, each followed by a
+ *   colon and a dwell time in milliseconds (eg. "109500000:500,110300000:250").
+ */
+std::vector<ScanStep> parse_scan_list(std::string const &list);
+
+/**
+ * Cycles a device through a list of frequencies, on its own thread, while it
+ * is receiving data.
+ *
+ * Each hop is announced to the process, which discards the buffers received
+ * while the tuner settles, clears the history of its filter, and tags the
+ * following blocks with the new frequency.  The time between a hop and the
+ * first block of the new frequency is measured, and reported when the scan
+ * stops.
+ */
+template<typename T>
+class Scanner {
+public:
+	Scanner() = delete;
+
+	/**
+	 * Starts scanning.
+	 *
+	 * @param device The device to tune.  It must be receiving data.
+	 * @param process The process receiving the data of the device.
+	 * @param steps The frequencies to cycle through, at least one.
+	 * @param settle The amount of buffers discarded after each hop.
+	 */
+	Scanner(Device<T> &device, Process<T> &process,
+		std::vector<ScanStep> steps, int settle):
+		device {device}, process {process}, steps {std::move(steps)},
+		settle {settle} {
+		if (this->steps.empty()) {
+			throw std::runtime_error {"The scan list is empty"};
+		}
+
+		thd = std::thread {&Scanner::run, this};
+	}
+
+	/**
+	 * Stops scanning, and prints statistics.
+	 */
+	~Scanner() {
+		{
+			std::lock_guard<std::mutex> lock {mutex};
+			stopping = true;
+		}
+
+		stopped.notify_one();
+		thd.join();
+
+		std::cout << "Scan: " << hops << " hops";
+
+		if (measured > 0) {
+			std::cout << ", retune latency min "
+				  << min_latency / 1e6 << " ms, mean "
+				  << total_latency / measured / 1e6
+				  << " ms, max " << max_latency / 1e6 << " ms";
+		}
+
+		std::cout << ", " << hops - measured
+			  << " without output" << std::endl;
+	}
+
+	Scanner(Scanner const &) = delete;
+	Scanner &operator=(Scanner const &) = delete;
+
+private:
+	void run() {
+		uint32_t frequency {0};
+
+		for (size_t i = 0;; i = (i + 1) % steps.size()) {
+			ScanStep const &step {steps[i]};
+
+			// A single frequency is tuned once.
+			if (step.frequency != frequency || hops == 0) {
+				process.begin_retune();
+
+				try {
+					device.set_frequency(step.frequency);
+					frequency = step.frequency;
+				} catch (std::runtime_error &e) {
+					log_limited(tune_errors,
+						    LogLevel::error,
+						    "Scan: could not tune to "
+						    "%u Hz", step.frequency);
+				}
+
+				process.end_retune(frequency, settle);
+				hops++;
+			}
+
+			std::unique_lock<std::mutex> lock {mutex};
+
+			if (stopped.wait_for(lock, step.dwell,
+					     [this] { return stopping; })) {
+				break;
+			}
+
+			lock.unlock();
+
+			// Read once the dwell time is over, so that the first
+			// block had the time to come out.
+			const int64_t latency {process.retune_latency()};
+
+			if (latency >= 0) {
+				min_latency = measured == 0 ? latency :
+					std::min(min_latency, latency);
+				max_latency = std::max(max_latency, latency);
+				total_latency += latency;
+				measured++;
+			}
+		}
+	}
+
+	Device<T> &device;
+	Process<T> &process;
+	const std::vector<ScanStep> steps;
+	const int settle;
+
+	std::mutex mutex;
+	std::condition_variable stopped;
+	bool stopping {false};
+
+	LogLimit tune_errors {std::chrono::seconds {1}};
+
+	uint64_t hops {0};
+	uint64_t measured {0};
+	int64_t min_latency {0}, max_latency {0}, total_latency {0};
+
+	std::thread thd;
+};
+
+#endif  /* __ILSIMU_RASSEIVER_SCANNER_HPP */
@@ -5,9 +5,17 @@
 #include <cstring>
 
 #include <arpa/inet.h>
+#include <linux/errqueue.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <sys/uio.h>
 
+#include "log.hpp"
 #include "sender.hpp"
 
+static_assert(sizeof(Metering) == protocol_metering_size,
+	      "Metering does not match the protocol");
+
 Fd::Fd(): fd {-1}, connected {false} {
 }
 
@@ -37,8 +45,9 @@ void Fd::close() {
 	}
 }
 
-Sender::Sender(std::string &&address, uint16_t port):
-	address {std::move(address)}, port {port} {
+Sender::Sender(std::string &&address, uint16_t port,
+	       SocketOptions const &options):
+	address {std::move(address)}, port {port}, options {options} {
 	reconnect();
 }
 
@@ -65,9 +74,237 @@ int Sender::reconnect() {
 		return -1;
 	}
 
+	apply_options(newFd.fd);
 	fd = std::move(newFd);
 
-	std::cout << "Connected to " << address << ":" << port << std::endl;
+	log_message(LogLevel::info, "Connected to %s:%u", address.c_str(),
+		    port);
 
 	return 0;
 }
+
+/**
+ * Sets an option of a socket.  If it fails, a warning is printed.
+ *
+ * @param fd The socket.
+ * @param level The level of the option, eg. IPPROTO_TCP.
+ * @param option The option.
+ * @param value Its new value.
+ * @param name The name of the option, used in the warning.
+ * @returns true if the option was set.
+ */
+static bool set_option(int fd, int level, int option, int value,
+		       char const *name) {
+	if (setsockopt(fd, level, option, &value, sizeof(value))) {
+		log_message(LogLevel::warning, "Could not set %s: %s", name,
+			    std::strerror(errno));
+		return false;
+	}
+
+	return true;
+}
+
+void Sender::apply_options(int fd) {
+	if (options.send_buffer > 0) {
+		set_option(fd, SOL_SOCKET, SO_SNDBUF, options.send_buffer,
+			   "SO_SNDBUF");
+	}
+
+	if (options.nodelay) {
+		set_option(fd, IPPROTO_TCP, TCP_NODELAY, 1, "TCP_NODELAY");
+	}
+
+	// The probes are sent every `keepalive' seconds too.
+	if (options.keepalive > 0 &&
+	    set_option(fd, SOL_SOCKET, SO_KEEPALIVE, 1, "SO_KEEPALIVE")) {
+		set_option(fd, IPPROTO_TCP, TCP_KEEPIDLE, options.keepalive,
+			   "TCP_KEEPIDLE");
+		set_option(fd, IPPROTO_TCP, TCP_KEEPINTVL, options.keepalive,
+			   "TCP_KEEPINTVL");
+	}
+
+	if (options.user_timeout > 0) {
+		set_option(fd, IPPROTO_TCP, TCP_USER_TIMEOUT,
+			   options.user_timeout, "TCP_USER_TIMEOUT");
+	}
+
+	// Without SO_ZEROCOPY (Linux < 4.14), the data is copied.
+	zerocopy_enabled = options.zerocopy &&
+		set_option(fd, SOL_SOCKET, SO_ZEROCOPY, 1, "SO_ZEROCOPY");
+	zerocopy_issued = 0;
+	zerocopy_done = 0;
+	zerocopy_reported = 0;
+}
+
+int Sender::send_block(Block const &block) {
+	int ret {};
+	Sender::Header header {
+		block.size,
+		static_cast<uint8_t> (
+			(block.saturation ? protocol_flag_saturation : 0) |
+			(block.has_metering ? protocol_flag_metering : 0) |
+			(block.compressed ? protocol_flag_compressed : 0) |
+			(block.has_frequency ? protocol_flag_frequency : 0) |
+			(block.has_timing ? protocol_flag_timing : 0) |
+			static_cast<uint8_t> (block.format) <<
+			protocol_format_shift)
+	};
+
+	if (fd.connected) {
+		// Uses Sender::header_size instead of sizeof(Sender::Header),
+		// as the structure may be padded with useless bits/bytes.
+		struct iovec iov[5];
+		struct msghdr msg {};
+		size_t n {0};
+
+		iov[n++] = {&header, Sender::header_size};
+
+		if (block.has_metering) {
+			iov[n++] = {const_cast<Metering *> (&block.metering),
+				    sizeof(Metering)};
+		}
+
+		if (block.has_frequency) {
+			iov[n++] = {const_cast<uint32_t *> (&block.frequency),
+				    sizeof(uint32_t)};
+		}
+
+		if (block.has_timing) {
+			iov[n++] = {const_cast<Timing *> (&block.timing),
+				    sizeof(Timing)};
+		}
+
+		if (zerocopy_enabled) {
+			msg.msg_iov = iov;
+			msg.msg_iovlen = n;
+
+			// The header is on the stack, so it is copied.
+			// MSG_MORE keeps it until the data is sent.
+			ret = sendmsg(fd.fd, &msg, MSG_NOSIGNAL | MSG_MORE);
+
+			if (ret >= 0) {
+				int data {send_pinned(block)};
+
+				ret = data < 0 ? -1 : ret + data;
+			}
+		} else {
+			iov[n++] = {const_cast<uint8_t *> (block.data.data()),
+				    block.size};
+
+			msg.msg_iov = iov;
+			msg.msg_iovlen = n;
+
+			ret = sendmsg(fd.fd, &msg, MSG_NOSIGNAL);
+		}
+	}
+
+	if (ret < 0) {
+		fd.close();
+	}
+
+	return ret;
+}
+
+int Sender::send_pinned(Block const &block) {
+	for (;;) {
+		ssize_t ret {send(fd.fd, block.data.data(), block.size,
+				  MSG_NOSIGNAL | MSG_ZEROCOPY)};
+
+		if (ret >= 0) {
+			zerocopy_issued++;
+			return ret;
+		}
+
+		// The notifications of the previous sends use the socket
+		// memory, which is limited by net.core.optmem_max.
+		if (errno != ENOBUFS || zerocopy_issued == zerocopy_done ||
+		    read_notifications(-1) < 0) {
+			return -1;
+		}
+	}
+}
+
+int Sender::read_notifications(int timeout) {
+	struct pollfd pfd {fd.fd, 0, 0};
+
+	// POLLERR is reported when a notification is queued.
+	if (timeout != 0 && poll(&pfd, 1, timeout) < 0 && errno != EINTR) {
+		return -1;
+	}
+
+	for (;;) {
+		char control[CMSG_SPACE(sizeof(struct sock_extended_err))];
+		struct msghdr msg {};
+
+		msg.msg_control = control;
+		msg.msg_controllen = sizeof(control);
+
+		if (recvmsg(fd.fd, &msg, MSG_ERRQUEUE | MSG_DONTWAIT) < 0) {
+			break;
+		}
+
+		struct cmsghdr *cmsg {CMSG_FIRSTHDR(&msg)};
+
+		if (cmsg == nullptr ||
+		    !((cmsg->cmsg_level == SOL_IP &&
+		       cmsg->cmsg_type == IP_RECVERR) ||
+		      (cmsg->cmsg_level == SOL_IPV6 &&
+		       cmsg->cmsg_type == IPV6_RECVERR))) {
+			continue;
+		}
+
+		struct sock_extended_err error;
+
+		std::memcpy(&error, CMSG_DATA(cmsg), sizeof(error));
+
+		if (error.ee_origin != SO_EE_ORIGIN_ZEROCOPY ||
+		    error.ee_errno != 0) {
+			continue;
+		}
+
+		// Sends [ee_info, ee_data] completed.
+		const uint32_t count {error.ee_data - error.ee_info + 1};
+
+		zerocopy_done = error.ee_data + 1;
+		zerocopy_total += count;
+
+		if (error.ee_code & SO_EE_CODE_ZEROCOPY_COPIED) {
+			zerocopy_copies += count;
+		}
+	}
+
+	if (errno != EAGAIN && errno != EWOULDBLOCK) {
+		return -1;
+	}
+
+	// POLLERR is also reported when the connection failed.
+	int error {0};
+	socklen_t length {sizeof(error)};
+
+	if ((pfd.revents & POLLHUP) ||
+	    getsockopt(fd.fd, SOL_SOCKET, SO_ERROR, &error, &length) ||
+	    error != 0) {
+		return -1;
+	}
+
+	return 0;
+}
+
+int Sender::completed(int timeout) {
+	if (!fd.connected) {
+		return -1;
+	}
+
+	// Some notifications may have been read by send_pinned() already.
+	if (read_notifications(zerocopy_done != zerocopy_reported ? 0 :
+			       timeout) < 0) {
+		fd.close();
+		return -1;
+	}
+
+	const int count = zerocopy_done - zerocopy_reported;
+
+	zerocopy_reported = zerocopy_done;
+
+	return count;
+}
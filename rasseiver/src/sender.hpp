@@ -6,6 +6,9 @@
 
 # include <sys/socket.h>
 
+# include "block.hpp"
+# include "protocol.hpp"
+
 /**
  * A RAII wrapper for file descriptors.  In this software, it is used for
  * sockets, but it may be used for other types of files (eg. inotify, etc.)
@@ -63,6 +66,41 @@ struct Fd {
 	void close();
 };
 
+/**
+ * The settings of the socket of a Sender.  The kernel defaults are kept for
+ * the settings equal to 0.
+ */
+struct SocketOptions {
+	/**
+	 * The size of the send buffer, in bytes (SO_SNDBUF).
+	 */
+	int send_buffer;
+
+	/**
+	 * Whether Nagle's algorithm is disabled (TCP_NODELAY).  Each block is
+	 * sent with a single system call, so this only delays small blocks.
+	 */
+	bool nodelay;
+
+	/**
+	 * The time a connection stays idle before it is checked with
+	 * keepalive probes, in seconds.
+	 */
+	int keepalive;
+
+	/**
+	 * The time sent data may remain unacknowledged before the connection
+	 * is closed, in milliseconds (TCP_USER_TIMEOUT).
+	 */
+	unsigned int user_timeout;
+
+	/**
+	 * Whether the data of the blocks is sent without being copied to the
+	 * kernel (MSG_ZEROCOPY).  See Sender::send_block().
+	 */
+	bool zerocopy;
+};
+
 /**
  * A class to manage a socket.
  */
@@ -76,8 +114,10 @@ public:
 	 *
 	 * @param address The address of the server to connect to.
 	 * @param port The port of the server.
+	 * @param options The settings of the socket.
 	 */
-	Sender(std::string &&address, uint16_t port);
+	Sender(std::string &&address, uint16_t port,
+	       SocketOptions const &options);
 
 	/**
 	 * Closes the connection.
@@ -89,42 +129,65 @@ public:
 	Sender &operator=(Sender const &) = delete;
 
 	/**
-	 * Sends a vector to the server.  The socket is closed if the operation
-	 * fails.
+	 * Sends a block of samples to the server.  The socket is closed if the
+	 * operation fails.
 	 *
 	 * A header is sent before the actual data, containing the amount of
 	 * data (in bytes, not counting the header size) that will be
 	 * transfered, and some flags (eg. whether the data is saturated or
-	 * not).  See the Sender::Header structure for more informations.
+	 * not, the format of the samples).  See protocol.hpp for more
+	 * informations.
+	 *
+	 * If the block has metering informations, they are sent right after
+	 * the header, and the corresponding flag is set.  The frequency and
+	 * the timing of the block are sent after them the same way.
 	 *
-	 * The vector is sent after the header.  Both are sent in little-endian.
+	 * The data is sent after the header.  Both are sent in little-endian,
+	 * with a single system call.
 	 *
-	 * @param v The vector to send to the server.
-	 * @param saturation Whether the data to send is saturated or not.
-	 *   Default to false.
+	 * With zero-copy sends, the header is copied to the kernel and the data
+	 * is sent by a second system call, which only pins it.  The data must
+	 * then not be modified until the send is reported by completed().
+	 *
+	 * @param block The block to send to the server.
 	 * @returns On success, this returns the amount of bytes sent.  On
 	 *   error, -1 is returned.
 	 */
-	template<typename T>
-	int send_vector(std::vector<T> const &v, bool saturation=false) {
-		int ret {};
-		Sender::Header header {v.size() * sizeof(T), saturation};
+	int send_block(Block const &block);
 
-		if (fd.connected) {
-			// Uses Sender::header_size instead of
-			// sizeof(Sender::Header), as the structure may be
-			// padded with useless bits/bytes.
-			ret = send(fd.fd, &header, Sender::header_size, MSG_NOSIGNAL);
+	/**
+	 * Reads the completion notifications of the zero-copy sends.  They
+	 * are reported in the order of the sends, as TCP releases the data
+	 * once it is acknowledged.
+	 *
+	 * @param timeout The time to wait for a notification, in
+	 *   milliseconds, 0 to return immediately, or -1 to wait until one
+	 *   arrives.
+	 * @returns The amount of sends completed since the last call, or -1
+	 *   if the connection failed, in which case the socket is closed.
+	 */
+	int completed(int timeout);
 
-			if (ret >= 0)
-				ret = send(fd.fd, v.data(), v.size() * sizeof(T), MSG_NOSIGNAL);
-		}
+	/**
+	 * Returns whether the data of the blocks is sent without being
+	 * copied.  This may be false even if it was requested, if the kernel
+	 * does not support it.
+	 */
+	bool zerocopy() const {
+		return zerocopy_enabled;
+	}
 
-		if (ret < 0) {
-			fd.close();
-		}
+	/**
+	 * Returns the amount of zero-copy sends completed, and the amount of
+	 * them for which the kernel copied the data anyway (eg. over the
+	 * loopback interface).
+	 */
+	uint64_t zerocopy_sends() const {
+		return zerocopy_total;
+	}
 
-		return ret;
+	uint64_t zerocopy_copied() const {
+		return zerocopy_copies;
 	}
 
 	/**
@@ -147,12 +210,7 @@ private:
 		const uint64_t size;
 
 		/**
-		 * Contains various flags:
-		 *   * First bit (LSB): whether the data to be sent is
-                 *                      saturated or not.
-		 *
-		 * The other bits are reserved for future use, and should be set
-		 * to 0.
+		 * Contains various flags, see protocol.hpp.
 		 */
 		const uint8_t flags;
 	};
@@ -168,12 +226,39 @@ private:
 	 * THIS VALUE SHOULD _ONLY_ BE USED TO COPY OR SEND A HEADER ON THE
 	 * NETWORK, _NOT_ FOR MEMORY ALLOCATION PURPOSES.
 	 */
-	static constexpr size_t header_size = 9;
+	static constexpr size_t header_size = protocol_header_size;
+
+	void apply_options(int fd);
+
+	/**
+	 * Sends the data of a block with MSG_ZEROCOPY.
+	 *
+	 * @returns The amount of bytes sent, or -1 on error.
+	 */
+	int send_pinned(Block const &block);
+
+	/**
+	 * Reads the queued completion notifications.
+	 *
+	 * @param timeout See completed().
+	 * @returns 0, or -1 if the connection failed.
+	 */
+	int read_notifications(int timeout);
 
 	const std::string address;
 	const uint16_t port;
+	const SocketOptions options;
 
 	Fd fd;
+
+	// The zero-copy sends of the current connection are numbered from 0 by
+	// the kernel.
+	bool zerocopy_enabled {false};
+	uint32_t zerocopy_issued {0};
+	uint32_t zerocopy_done {0};
+	uint32_t zerocopy_reported {0};
+	uint64_t zerocopy_total {0};
+	uint64_t zerocopy_copies {0};
 };
 
 #endif  /* __ILSIMU_RASSEIVER_SENDER_HPP */
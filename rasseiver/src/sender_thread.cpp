@@ -0,0 +1,195 @@
+#include <algorithm>
+#include <iostream>
+#include <stdexcept>
+
+#include "alloc_guard.hpp"
+#include "log.hpp"
+#include "sender_thread.hpp"
+
+SenderThread::SenderThread(BlockPool &pool, OutputOptions const &options):
+	pool {pool},
+	sender {std::string {options.host}, options.port, options.socket},
+	compression {options.compression},
+	encoder {compression ? pool.capacity() / sizeof(int16_t) : 0},
+	encoded {compression ?
+		Encoder::max_size(pool.capacity() / sizeof(int16_t)) : 0,
+		PageAllocator<uint8_t> {"compressed output", pool.node()}},
+	max_in_flight {std::max<size_t> (pool.size() / 2, 1)} {
+	if (compression && options.format != SampleFormat::int16) {
+		throw std::runtime_error {
+			"Compression requires the int16 output format"};
+	}
+
+	// The compressed block is reused as soon as it is sent.
+	if (compression && options.socket.zerocopy) {
+		throw std::runtime_error {
+			"Zero-copy sends are not available with compression"};
+	}
+
+	in_flight.reserve(pool.size());
+
+	thd = std::thread {&SenderThread::run, this, options.thread};
+}
+
+SenderThread::~SenderThread() {
+	pool.close();
+	thd.join();
+
+	std::cout << "Sent " << blocks_sent << " blocks, dropped "
+		  << pool.dropped() << std::endl;
+
+	if (compression && bytes_in > 0) {
+		double seconds {std::chrono::duration<double> (
+				encoding_time).count()};
+
+		std::cout << "Compression: " << bytes_in << " -> " << bytes_out
+			  << " bytes (ratio " << (double) bytes_in / bytes_out
+			  << "), " << bytes_in / seconds / 1e6
+			  << " MB/s on one core" << std::endl;
+	}
+
+	if (blocks_sent > 1) {
+		const double seconds {std::chrono::duration<double> (
+				last_send - first_send).count()};
+
+		std::cout << "Output latency: min/mean/max "
+			  << latency_min / 1e6 << "/"
+			  << latency_sum / 1e6 / blocks_sent << "/"
+			  << latency_max / 1e6 << " ms, "
+			  << (blocks_sent - 1) / seconds << " blocks/s"
+			  << std::endl;
+	}
+
+	if (sender.zerocopy_sends() > 0) {
+		std::cout << "Zero-copy: " << sender.zerocopy_sends()
+			  << " sends, " << sender.zerocopy_copied()
+			  << " copied by the kernel" << std::endl;
+	}
+}
+
+bool SenderThread::send(Block const &block) {
+	int ret;
+
+	{
+		AllocGuard guard;
+		ret = sender.send_block(block);
+	}
+
+	if (ret <= 0) {
+		sender.reconnect();
+		return false;
+	}
+
+	// From the capture of the oldest input of the block to the end of its
+	// send, so the wait for the rest of its buffer counts too.
+	last_send = std::chrono::steady_clock::now();
+
+	const int64_t latency {std::chrono::duration_cast<
+		std::chrono::nanoseconds> (
+			last_send.time_since_epoch()).count() -
+		block.timing.monotonic};
+
+	if (blocks_sent++ == 0) {
+		first_send = last_send;
+	}
+
+	latency_min = std::min(latency_min, latency);
+	latency_max = std::max(latency_max, latency);
+	latency_sum += latency;
+
+	return true;
+}
+
+void SenderThread::send_pinned(Block *block) {
+	if (!send(*block)) {
+		// The sends of the closed connection will not be reported.
+		pool.release(block);
+		release_sent(in_flight.size());
+		return;
+	}
+
+	AllocGuard guard;
+	int count;
+
+	in_flight.push_back(block);
+
+	do {
+		count = sender.completed(
+			in_flight.size() >= max_in_flight ? -1 : 0);
+		release_sent(count < 0 ? in_flight.size() : count);
+	} while (count == 0 && in_flight.size() >= max_in_flight);
+}
+
+void SenderThread::release_sent(size_t count) {
+	count = std::min(count, in_flight.size());
+
+	for (size_t i = 0; i < count; i++) {
+		pool.release(in_flight[i]);
+	}
+
+	in_flight.erase(in_flight.begin(), in_flight.begin() + count);
+}
+
+void SenderThread::run(ThreadPolicy policy) {
+	uint64_t reported_drops {0};
+	Block *block;
+
+	apply_thread_policy(policy, "sender");
+
+	while ((block = pool.next()) != nullptr) {
+		if (compression) {
+			auto start = std::chrono::steady_clock::now();
+
+			{
+				AllocGuard guard;
+				encoded.size = encoder.encode(
+					reinterpret_cast<int16_t const *> (
+						block->data.data()),
+					block->size / sizeof(int16_t),
+					encoded.data.data());
+			}
+
+			encoding_time += std::chrono::steady_clock::now() - start;
+			bytes_in += block->size;
+			bytes_out += encoded.size;
+
+			encoded.format = block->format;
+			encoded.saturation = block->saturation;
+			encoded.compressed = true;
+			encoded.metering = block->metering;
+			encoded.has_metering = block->has_metering;
+			encoded.frequency = block->frequency;
+			encoded.has_frequency = block->has_frequency;
+			encoded.timing = block->timing;
+			encoded.has_timing = block->has_timing;
+
+			pool.release(block);
+			send(encoded);
+		} else if (sender.zerocopy()) {
+			send_pinned(block);
+		} else {
+			send(*block);
+			pool.release(block);
+		}
+
+		// The drops are summed until they are reported.
+		const uint64_t dropped {pool.dropped()};
+
+		if (dropped != reported_drops && drops_limit.allow()) {
+			log_message(LogLevel::warning,
+				    "Dropped %lu output blocks",
+				    static_cast<unsigned long> (
+					    dropped - reported_drops));
+			reported_drops = dropped;
+		}
+	}
+
+	// Waits for the last notifications, so that they are counted.
+	int count;
+
+	while (!in_flight.empty() && (count = sender.completed(1000)) > 0) {
+		release_sent(count);
+	}
+
+	release_sent(in_flight.size());
+}
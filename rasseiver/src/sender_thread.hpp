@@ -0,0 +1,139 @@
+#ifndef __ILSIMU_RASSEIVER_SENDER_THREAD_HPP
+# define __ILSIMU_RASSEIVER_SENDER_THREAD_HPP
+
+# include <chrono>
+# include <string>
+# include <thread>
+# include <vector>
+
+# include "block_pool.hpp"
+# include "codec.hpp"
+# include "log.hpp"
+# include "realtime.hpp"
+# include "sender.hpp"
+
+/**
+ * The parameters of the output of a process.
+ */
+struct OutputOptions {
+	std::string host;
+	uint16_t port;
+
+	/**
+	 * The format of the samples, and the factor by which they are
+	 * multiplied before being converted.
+	 */
+	SampleFormat format;
+	double scale;
+
+	/**
+	 * The rate of the output samples, in Hz, and the length of the
+	 * windows measured with the ils format, in seconds.
+	 */
+	double rate;
+	double ils_period;
+
+	/**
+	 * The rate of the input IQ samples, in Hz.
+	 */
+	double input_rate;
+
+	/**
+	 * Whether the statistics of the raw input are sent with each block.
+	 */
+	bool metering;
+
+	/**
+	 * Whether the sequence number and the timestamps of each block are
+	 * sent with it.
+	 */
+	bool timing;
+
+	/**
+	 * Whether blocks are compressed before being sent.  Only available with
+	 * the int16 format.
+	 */
+	bool compression;
+
+	/**
+	 * The amount of blocks that can wait to be sent.  With
+	 * `block_samples', it is counted in buffers of the device.
+	 */
+	size_t queue_size;
+
+	/**
+	 * The amount of IQ samples of each output block, or 0 to send the
+	 * output of each buffer of the device as a block.
+	 */
+	size_t block_samples;
+
+	/**
+	 * The CPUs and scheduling of the sender thread.
+	 */
+	ThreadPolicy thread;
+
+	/**
+	 * The settings of the socket.
+	 */
+	SocketOptions socket;
+};
+
+/**
+ * Sends the blocks of a BlockPool to a server, on its own thread.
+ *
+ * This keeps network operations, reconnections and compression out of the
+ * device callback.
+ *
+ * With zero-copy sends, a block is only released once the kernel reports
+ * that its data was sent.  At most half of the blocks of the pool wait for
+ * their notifications, so that the device callback always finds free
+ * blocks.
+ */
+class SenderThread {
+public:
+	SenderThread() = delete;
+
+	/**
+	 * Connects to the server and starts the thread.
+	 *
+	 * @param pool The pool from which blocks are sent.
+	 * @param options The output parameters.
+	 */
+	SenderThread(BlockPool &pool, OutputOptions const &options);
+
+	/**
+	 * Sends the remaining blocks, stops the thread and prints statistics.
+	 */
+	~SenderThread();
+
+	SenderThread(SenderThread const &) = delete;
+	SenderThread &operator=(SenderThread const &) = delete;
+
+private:
+	void run(ThreadPolicy policy);
+	bool send(Block const &block);
+	void send_pinned(Block *block);
+	void release_sent(size_t count);
+
+	BlockPool &pool;
+	Sender sender;
+
+	const bool compression;
+	Encoder encoder;
+	Block encoded;
+
+	// The blocks sent with MSG_ZEROCOPY, in the order of the sends.
+	std::vector<Block *> in_flight;
+	const size_t max_in_flight;
+
+	uint64_t blocks_sent {0};
+	std::chrono::steady_clock::time_point first_send, last_send;
+	int64_t latency_min {INT64_MAX}, latency_max {0}, latency_sum {0};
+	uint64_t bytes_in {0}, bytes_out {0};
+	std::chrono::steady_clock::duration encoding_time {};
+	LogLimit drops_limit {std::chrono::seconds {1}};
+
+	std::thread thd;
+};
+
+#endif  /* __ILSIMU_RASSEIVER_SENDER_THREAD_HPP */
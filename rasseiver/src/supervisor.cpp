@@ -0,0 +1,88 @@
+#include <cerrno>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+
+#include <poll.h>
+#include <sys/signalfd.h>
+#include <sys/timerfd.h>
+#include <unistd.h>
+
+#include "supervisor.hpp"
+
+/**
+ * Throws a std::runtime_error describing the last error of a call.
+ *
+ * @param call The name of the call that failed.
+ */
+[[noreturn]] static void throw_errno(char const *call) {
+	throw std::runtime_error {std::string {call} + "() failed: " +
+			std::strerror(errno)};
+}
+
+Supervisor::Supervisor(sigset_t const &set) {
+	int fd {signalfd(-1, &set, SFD_CLOEXEC)};
+
+	if (fd < 0) {
+		throw_errno("signalfd");
+	}
+
+	signals = Fd {std::move(fd)};
+	fd = timerfd_create(CLOCK_MONOTONIC, TFD_CLOEXEC);
+
+	if (fd < 0) {
+		throw_errno("timerfd_create");
+	}
+
+	timer = Fd {std::move(fd)};
+}
+
+void Supervisor::set_timer(std::chrono::milliseconds period) {
+	const auto seconds =
+		std::chrono::duration_cast<std::chrono::seconds> (period);
+	const auto nanoseconds =
+		std::chrono::duration_cast<std::chrono::nanoseconds> (
+			period - seconds);
+	itimerspec spec {};
+
+	spec.it_interval.tv_sec = seconds.count();
+	spec.it_interval.tv_nsec = nanoseconds.count();
+	spec.it_value = spec.it_interval;
+
+	if (timerfd_settime(timer.fd, 0, &spec, nullptr)) {
+		throw_errno("timerfd_settime");
+	}
+}
+
+int Supervisor::wait() {
+	pollfd fds[2] {{signals.fd, POLLIN, 0}, {timer.fd, POLLIN, 0}};
+
+	for (;;) {
+		if (poll(fds, 2, -1) < 0) {
+			if (errno == EINTR) {
+				continue;
+			}
+
+			throw_errno("poll");
+		}
+
+		if (fds[0].revents & POLLIN) {
+			signalfd_siginfo info;
+
+			if (read(signals.fd, &info, sizeof(info)) ==
+			    sizeof(info)) {
+				return info.ssi_signo;
+			}
+		}
+
+		if (fds[1].revents & POLLIN) {
+			uint64_t expirations;
+
+			// The missed ticks are merged.
+			if (read(timer.fd, &expirations, sizeof(expirations)) ==
+			    sizeof(expirations)) {
+				return 0;
+			}
+		}
+	}
+}
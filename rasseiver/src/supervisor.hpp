@@ -0,0 +1,54 @@
+#ifndef __ILSIMU_RASSEIVER_SUPERVISOR_HPP
+# define __ILSIMU_RASSEIVER_SUPERVISOR_HPP
+
+# include <chrono>
+
+# include <csignal>
+
+# include "sender.hpp"
+
+/**
+ * Waits for signals and for the ticks of a periodic timer on the main thread.
+ *
+ * The signals are read from a signalfd and the ticks from a timerfd, polled
+ * together, so that the devices can be checked several times a second
+ * without alarm(), and a signal is handled as soon as it is received.
+ */
+class Supervisor {
+public:
+	Supervisor() = delete;
+
+	/**
+	 * Creates the descriptors.  The timer is disarmed.  If they cannot be
+	 * created, a std::runtime_error is thrown.
+	 *
+	 * @param set The signals to wait for.  They must be blocked in every
+	 *   thread.
+	 */
+	explicit Supervisor(sigset_t const &set);
+
+	Supervisor(Supervisor const &) = delete;
+	Supervisor &operator=(Supervisor const &) = delete;
+
+	/**
+	 * Arms the timer.  It expires every `period', starting one period
+	 * from now.
+	 *
+	 * @param period The period of the timer, strictly positive.
+	 */
+	void set_timer(std::chrono::milliseconds period);
+
+	/**
+	 * Waits for a signal of the set, or for the timer.  Signals are
+	 * returned first if both are pending.
+	 *
+	 * @returns The number of the signal, or 0 if the timer expired.
+	 */
+	int wait();
+
+private:
+	Fd signals;
+	Fd timer;
+};
+
+#endif  /* __ILSIMU_RASSEIVER_SUPERVISOR_HPP */
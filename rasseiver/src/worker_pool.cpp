@@ -0,0 +1,155 @@
+#include <algorithm>
+#include <stdexcept>
+
+#include <cerrno>
+
+#include "worker_pool.hpp"
+
+WorkerPool::Slot::Slot() {
+	if (sem_init(&finished, 0, 0)) {
+		throw std::runtime_error {"sem_init() failed"};
+	}
+}
+
+WorkerPool::Slot::~Slot() {
+	sem_destroy(&finished);
+}
+
+WorkerPool::WorkerPool(size_t count, size_t slots,
+		       ThreadPolicy const &policy):
+	slots {new Slot[slots]}, slot_count {slots} {
+	if (sem_init(&start, 0, 0)) {
+		throw std::runtime_error {"sem_init() failed"};
+	}
+
+	threads.reserve(count);
+
+	for (size_t i = 0; i < count; i++) {
+		// Each thread is pinned to a single CPU of the list.
+		ThreadPolicy own {{}, policy.priority};
+
+		if (!policy.cpus.empty()) {
+			own.cpus.push_back(policy.cpus[i % policy.cpus.size()]);
+		}
+
+		threads.emplace_back(&WorkerPool::work, this, i, own);
+	}
+}
+
+WorkerPool::~WorkerPool() {
+	stopping = true;
+
+	for (size_t i = 0; i < threads.size(); i++) {
+		sem_post(&start);
+	}
+
+	for (auto &thread: threads) {
+		thread.join();
+	}
+
+	sem_destroy(&start);
+}
+
+size_t WorkerPool::attach() {
+	for (size_t i = 0; i < slot_count; i++) {
+		if (!slots[i].attached.exchange(true)) {
+			return i;
+		}
+	}
+
+	throw std::runtime_error {"No free slot in the worker pool"};
+}
+
+void WorkerPool::detach(size_t slot) {
+	slots[slot].attached = false;
+}
+
+void WorkerPool::run(size_t id, Task task, void *context, size_t count) {
+	Slot &slot {slots[id]};
+
+	if (count == 0) {
+		return;
+	}
+
+	const size_t helpers {std::min(threads.size(), count - 1)};
+	const uint64_t generation {
+		(slot.state.load(std::memory_order_relaxed) >> 32) + 1};
+
+	slot.task.store(task, std::memory_order_relaxed);
+	slot.context.store(context, std::memory_order_relaxed);
+	slot.count.store(count, std::memory_order_relaxed);
+	slot.remaining.store(count, std::memory_order_relaxed);
+	slot.state.store(generation << 32, std::memory_order_release);
+
+	for (size_t i = 0; i < helpers; i++) {
+		sem_post(&start);
+	}
+
+	while (take_task(slot)) {
+	}
+
+	// Some tasks may still be running on other threads.
+	while (sem_wait(&slot.finished) && errno == EINTR) {
+	}
+
+	slot.state.store((generation + 1) << 32, std::memory_order_release);
+}
+
+void WorkerPool::work(size_t id, ThreadPolicy policy) {
+	apply_thread_policy(policy, "filtering");
+
+	for (;;) {
+		while (sem_wait(&start) && errno == EINTR) {
+		}
+
+		if (stopping) {
+			return;
+		}
+
+		// Steal tasks until no job has any left.  Each thread starts
+		// with a different slot, to spread the threads over the jobs.
+		bool found;
+
+		do {
+			found = false;
+
+			for (size_t i = 0; i < slot_count; i++) {
+				while (take_task(slots[(id + i) % slot_count])) {
+					found = true;
+				}
+			}
+		} while (found);
+	}
+}
+
+bool WorkerPool::take_task(Slot &slot) {
+	uint64_t state {slot.state.load(std::memory_order_acquire)};
+
+	for (;;) {
+		const size_t index {state & 0xffffffff};
+
+		if (((state >> 32) & 1) == 0 ||
+		    index >= slot.count.load(std::memory_order_relaxed)) {
+			return false;
+		}
+
+		// If the job is over, or another thread took the task, the
+		// exchange fails and the state is reloaded.  Otherwise, the job
+		// cannot be over before the task is done, so its parameters
+		// are stable.
+		if (slot.state.compare_exchange_weak(state, state + 1,
+						     std::memory_order_acq_rel,
+						     std::memory_order_acquire)) {
+			slot.task.load(std::memory_order_relaxed)(
+				slot.context.load(std::memory_order_relaxed),
+				index);
+
+			if (slot.remaining.fetch_sub(
+				    1, std::memory_order_acq_rel) == 1) {
+				sem_post(&slot.finished);
+			}
+
+			return true;
+		}
+	}
+}
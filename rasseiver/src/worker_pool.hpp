@@ -0,0 +1,125 @@
+#ifndef __ILSIMU_RASSEIVER_WORKER_POOL_HPP
+# define __ILSIMU_RASSEIVER_WORKER_POOL_HPP
+
+# include <atomic>
+# include <memory>
+# include <thread>
+# include <vector>
+
+# include <semaphore.h>
+
+# include "realtime.hpp"
+
+/**
+ * A fixed set of threads, each optionally pinned to a CPU, sharing the work of
+ * several callers (eg. the callbacks of several devices).
+ *
+ * Each caller owns a job slot, obtained with attach().  run() splits a job into
+ * tasks identified by their index, and publishes it in the slot of the caller.
+ * The caller takes part in its own job, and idle threads steal the tasks of any
+ * published job, one at a time, so the threads go where the work is: a busy
+ * device gets more help than a quiet one, and a slow or preempted thread does
+ * not delay a whole job.  Nothing is allocated after construction, so a job
+ * may be run from a device callback.
+ */
+class WorkerPool {
+public:
+	/**
+	 * A task: `context' is the one given to run(), and `index' the index
+	 * of the task, lower than the amount of tasks of the job.
+	 */
+	using Task = void (*)(void *context, size_t index);
+
+	WorkerPool() = delete;
+
+	/**
+	 * Starts the threads.
+	 *
+	 * @param threads The amount of threads to start, besides the threads
+	 *   calling run().
+	 * @param slots The maximum amount of callers attached at the same
+	 *   time.
+	 * @param policy The CPUs and scheduling of the threads.  Each thread
+	 *   is pinned to a single CPU of the list, in turn.
+	 */
+	WorkerPool(size_t threads, size_t slots, ThreadPolicy const &policy);
+
+	/**
+	 * Stops and joins the threads.  No caller may be attached anymore.
+	 */
+	~WorkerPool();
+
+	WorkerPool(WorkerPool const &) = delete;
+	WorkerPool &operator=(WorkerPool const &) = delete;
+
+	/**
+	 * Reserves a job slot for a caller.  If all slots are taken, a
+	 * std::runtime_error is thrown.
+	 *
+	 * @returns The slot, to be given to run() and detach().
+	 */
+	size_t attach();
+
+	/**
+	 * Gives a job slot back.
+	 *
+	 * @param slot A slot returned by attach(), with no job running.
+	 */
+	void detach(size_t slot);
+
+	/**
+	 * Runs a job, and returns once all its tasks are done.
+	 *
+	 * @param slot The slot of the caller.
+	 * @param task The function running a task.
+	 * @param context The context passed to each task.
+	 * @param count The amount of tasks.
+	 */
+	void run(size_t slot, Task task, void *context, size_t count);
+
+	/**
+	 * Returns the amount of threads of the pool, besides the threads
+	 * calling run().
+	 */
+	size_t size() const {
+		return threads.size();
+	}
+
+private:
+	/**
+	 * A job slot.  The generation and the index of the next task to take
+	 * are packed in `state', so that a thread cannot take a task of a job
+	 * which is already over: the generation is odd while a job is
+	 * published, and incremented when it is published and when it is
+	 * over.
+	 */
+	struct Slot {
+		Slot();
+		~Slot();
+
+		std::atomic<uint64_t> state {0};
+		std::atomic<Task> task {nullptr};
+		std::atomic<void *> context {nullptr};
+		std::atomic<size_t> count {0};
+		std::atomic<size_t> remaining {0};
+		std::atomic<bool> attached {false};
+
+		// Posted by the thread finishing the last task of the job.
+		sem_t finished;
+
+		// Slots are taken by different threads.
+		char padding[64];
+	};
+
+	void work(size_t id, ThreadPolicy policy);
+	bool take_task(Slot &slot);
+
+	std::vector<std::thread> threads;
+	std::unique_ptr<Slot[]> slots;
+	const size_t slot_count;
+
+	sem_t start;
+	std::atomic<bool> stopping {false};
+};
+
+#endif  /* __ILSIMU_RASSEIVER_WORKER_POOL_HPP */
@@ -0,0 +1,20 @@
+#include "buffer_pool.hpp"
+
+BufferPool::BufferPool(size_t size): size {size} {
+}
+
+uint8_t *BufferPool::acquire() {
+	if (free_buffers.empty()) {
+		buffers.emplace_back(new uint8_t[size]);
+		return buffers.back().get();
+	}
+
+	uint8_t *buffer {free_buffers.back()};
+	free_buffers.pop_back();
+
+	return buffer;
+}
+
+void BufferPool::release(uint8_t *buffer) {
+	free_buffers.push_back(buffer);
+}
@@ -0,0 +1,52 @@
+#ifndef __ILSIMU_RASSERVER_BUFFER_POOL_HPP
+# define __ILSIMU_RASSERVER_BUFFER_POOL_HPP
+
+# include <memory>
+# include <vector>
+
+# include <cstddef>
+# include <cstdint>
+
+/**
+ * A set of receive buffers of the same size, reused by the connections, so
+ * that accepting and closing connections does not allocate memory once the
+ * pool has grown to the highest amount of simultaneous connections.
+ */
+class BufferPool {
+public:
+	BufferPool() = delete;
+
+	/**
+	 * Creates an empty pool.
+	 *
+	 * @param size The size of each buffer, in bytes.
+	 */
+	BufferPool(size_t size);
+
+	BufferPool(BufferPool const &) = delete;
+	BufferPool &operator=(BufferPool const &) = delete;
+
+	/**
+	 * Takes a free buffer, or allocates one if none is free.
+	 */
+	uint8_t *acquire();
+
+	/**
+	 * Gives back a buffer returned by acquire().
+	 */
+	void release(uint8_t *buffer);
+
+	/**
+	 * Returns the size of each buffer, in bytes.
+	 */
+	size_t buffer_size() const {
+		return size;
+	}
+
+private:
+	const size_t size;
+	std::vector<std::unique_ptr<uint8_t[]>> buffers;
+	std::vector<uint8_t *> free_buffers;
+};
+
+#endif  /* __ILSIMU_RASSERVER_BUFFER_POOL_HPP */
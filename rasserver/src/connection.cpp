@@ -0,0 +1,281 @@
+#include "connection.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include <stdexcept>
+
+#include <cerrno>
+#include <cstring>
+
+#include <fcntl.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include "ils_meter.hpp"
+#include "protocol.hpp"
+#include "sample_format.hpp"
+
+/**
+ * Returns the size of the data of an IQ sample (or of an ils record) in a
+ * format, or 0 if the format is unknown.
+ *
+ * @param format The format, from the flags of a header.
+ */
+static size_t sample_size(size_t format) {
+	const SampleFormat sample_format {static_cast<SampleFormat> (format)};
+
+	if (sample_format == SampleFormat::ils) {
+		return sizeof(IlsRecord);
+	}
+
+	return 2 * sample_format_size(sample_format);
+}
+
+/**
+ * Reads a little-endian integer.
+ */
+template<typename I>
+static I read_le(uint8_t const *data) {
+	I value {0};
+
+	for (size_t i = 0; i < sizeof(I); i++) {
+		value |= static_cast<I> (data[i]) << (i * 8);
+	}
+
+	return value;
+}
+
+StreamStats &StreamStats::operator+=(StreamStats const &other) {
+	blocks += other.blocks;
+	bytes += other.bytes;
+	samples += other.samples;
+	saturated += other.saturated;
+	timed += other.timed;
+	lost += other.lost;
+	dropped += other.dropped;
+	latency_sum += other.latency_sum;
+	latency_max = std::max(latency_max, other.latency_max);
+
+	return *this;
+}
+
+void print_stats(std::string const &name, StreamStats const &stats,
+		 double seconds, bool records) {
+	std::cout << "[" << name << "] " << stats.blocks / seconds
+		  << " blocks/s, " << stats.bytes / seconds / 1e6 << " MB/s, ";
+
+	if (records) {
+		std::cout << stats.samples / seconds << " records/s, ";
+	} else {
+		std::cout << stats.samples / seconds / 1e3 << " kS/s, ";
+	}
+
+	std::cout << (stats.blocks > 0 ?
+		      100. * stats.saturated / stats.blocks : 0)
+		  << "% saturated";
+
+	if (stats.timed > 0) {
+		std::cout << ", latency mean/max "
+			  << stats.latency_sum / 1e6 / stats.timed << "/"
+			  << stats.latency_max / 1e6 << " ms, " << stats.lost
+			  << " blocks lost, " << stats.dropped
+			  << " samples dropped";
+	}
+
+	std::cout << std::endl;
+}
+
+Connection::Connection(int socket, std::string name, BufferPool &pool,
+		       std::string const &file):
+	socket {socket}, peer {std::move(name)}, pool {pool},
+	buffer {pool.acquire()} {
+	if (!file.empty()) {
+		this->file = open(file.c_str(), O_WRONLY | O_CREAT | O_TRUNC,
+				  0644);
+
+		if (this->file < 0) {
+			pool.release(buffer);
+			close(socket);
+			throw std::runtime_error {"Could not create " + file +
+					": " + std::strerror(errno)};
+		}
+	}
+}
+
+Connection::~Connection() {
+	if (file >= 0) {
+		close(file);
+	}
+
+	close(socket);
+	pool.release(buffer);
+}
+
+bool Connection::receive() {
+	ssize_t ret {recv(socket, buffer + filled, pool.buffer_size() - filled,
+			  0)};
+
+	if (ret == 0) {
+		return false;
+	} else if (ret < 0) {
+		if (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR) {
+			return true;
+		}
+
+		std::cerr << "[" << peer << "] " << std::strerror(errno)
+			  << std::endl;
+		return false;
+	}
+
+	size_t parsed {0};
+
+	filled += ret;
+
+	const bool valid {parse(parsed)};
+
+	if (parsed > 0 && !save(buffer, parsed)) {
+		return false;
+	}
+
+	// Only the beginning of an incomplete block is left.
+	std::memmove(buffer, buffer + parsed, filled - parsed);
+	filled -= parsed;
+
+	return valid;
+}
+
+bool Connection::parse(size_t &parsed) {
+	while (filled - parsed >= protocol_header_size) {
+		uint8_t const *header {buffer + parsed};
+		const uint64_t size {read_le<uint64_t> (header)};
+		const uint8_t flags {header[8]};
+		const size_t format {static_cast<size_t> (
+				(flags & protocol_format_mask) >>
+				protocol_format_shift)};
+		const size_t fixed {protocol_header_size +
+				    protocol_records_size(flags)};
+		const size_t sample_bytes {sample_size(format)};
+
+		if ((flags & ~protocol_known_flags) != 0 || sample_bytes == 0) {
+			std::cerr << "[" << peer << "] Bad header flags 0x"
+				  << std::hex << +flags << std::dec
+				  << std::endl;
+			return false;
+		}
+
+		// The size of the timing record is in the record.
+		if (filled - parsed < fixed) {
+			break;
+		}
+
+		const size_t offset {protocol_header_size +
+				     protocol_records_size(
+					     flags, header +
+					     protocol_header_size)};
+
+		if (offset < fixed) {
+			std::cerr << "[" << peer << "] Bad timing record"
+				  << std::endl;
+			return false;
+		}
+
+		if (offset > pool.buffer_size() ||
+		    size > pool.buffer_size() - offset) {
+			std::cerr << "[" << peer << "] Block of " << size
+				  << " bytes larger than the buffer"
+				  << std::endl;
+			return false;
+		}
+
+		if (filled - parsed < offset + size) {
+			break;
+		}
+
+		uint8_t const *data {header + offset};
+
+		interval.blocks++;
+		interval.bytes += offset + size;
+		interval.saturated += (flags & protocol_flag_saturation) != 0;
+		records = format == static_cast<size_t> (SampleFormat::ils);
+
+		if (flags & protocol_flag_timing) {
+			check_timing(header + fixed - protocol_timing_size);
+		}
+
+		// A compressed block starts with its amount of samples.
+		if (flags & protocol_flag_compressed) {
+			interval.samples += size >= 4 ?
+				read_le<uint32_t> (data) : 0;
+		} else {
+			interval.samples += size / sample_bytes;
+		}
+
+		parsed += offset + size;
+	}
+
+	return true;
+}
+
+/**
+ * Counts the blocks lost before a block, the samples dropped, and the latency
+ * of the block, from its timing record.
+ *
+ * @param timing The record.
+ */
+void Connection::check_timing(uint8_t const *timing) {
+	const uint64_t sequence {read_le<uint64_t> (timing + 8)};
+	const uint64_t total_dropped {read_le<uint64_t> (timing + 24)};
+	const int64_t realtime {read_le<int64_t> (timing + 32)};
+	const int64_t latency {std::chrono::duration_cast<
+		std::chrono::nanoseconds> (
+			std::chrono::system_clock::now()
+			.time_since_epoch()).count() - realtime};
+
+	if (sequence > next_sequence) {
+		interval.lost += sequence - next_sequence;
+	}
+
+	if (total_dropped > dropped) {
+		interval.dropped += total_dropped - dropped;
+	}
+
+	next_sequence = sequence + 1;
+	dropped = total_dropped;
+
+	interval.timed++;
+	interval.latency_sum += latency;
+	interval.latency_max = std::max(interval.latency_max, latency);
+}
+
+bool Connection::save(uint8_t const *data, size_t size) {
+	while (file >= 0 && size > 0) {
+		ssize_t ret {write(file, data, size)};
+
+		if (ret < 0) {
+			if (errno == EINTR) {
+				continue;
+			}
+
+			std::cerr << "[" << peer << "] Could not write the "
+				  << "stream: " << std::strerror(errno)
+				  << std::endl;
+			return false;
+		}
+
+		data += ret;
+		size -= ret;
+	}
+
+	return true;
+}
+
+StreamStats Connection::report(double seconds) {
+	const StreamStats stats {interval};
+
+	print_stats(peer, stats, seconds, records);
+	totals += stats;
+	interval = {};
+
+	return stats;
+}
@@ -0,0 +1,128 @@
+#ifndef __ILSIMU_RASSERVER_CONNECTION_HPP
+# define __ILSIMU_RASSERVER_CONNECTION_HPP
+
+# include <string>
+
+# include "buffer_pool.hpp"
+
+/**
+ * Counters of a stream, over an interval or since the connection.
+ */
+struct StreamStats {
+	uint64_t blocks;
+	uint64_t bytes;      // Headers, records and data
+	uint64_t samples;    // IQ samples, or records with the ils format
+	uint64_t saturated;  // Blocks with the saturation flag
+
+	/**
+	 * From the blocks with a timing record: the blocks missing from the
+	 * sequence, the samples dropped by the device, and the time between
+	 * the capture and the reception, in nanoseconds.
+	 */
+	uint64_t timed;
+	uint64_t lost;
+	uint64_t dropped;
+	int64_t latency_sum;
+	int64_t latency_max;
+
+	StreamStats &operator+=(StreamStats const &other);
+};
+
+/**
+ * A connection from rasseiver.
+ *
+ * The stream is received directly in a buffer of the pool, and the blocks
+ * are parsed where they were received: the data is never copied, except for
+ * the beginning of an incomplete block, which is moved to the beginning of
+ * the buffer.  The complete blocks are written to a file, if any, straight
+ * from the buffer.
+ */
+class Connection {
+public:
+	Connection() = delete;
+
+	/**
+	 * Takes the ownership of an accepted socket.  If the file cannot be
+	 * created, a std::runtime_error is thrown.
+	 *
+	 * @param socket The socket, non-blocking.
+	 * @param name The name of the connection in reports, usually the
+	 *   address of the peer.
+	 * @param pool The pool of receive buffers.  It must outlive the
+	 *   connection.
+	 * @param file The file where the stream is written, or an empty
+	 *   string.
+	 */
+	Connection(int socket, std::string name, BufferPool &pool,
+		   std::string const &file);
+
+	/**
+	 * Closes the socket and the file, and releases the buffer.
+	 */
+	~Connection();
+
+	Connection(Connection const &) = delete;
+	Connection &operator=(Connection const &) = delete;
+
+	/**
+	 * Receives what the socket holds, and parses the complete blocks.
+	 * Errors are reported.
+	 *
+	 * @returns false if the connection was closed by the peer, or if it
+	 *   must be closed (the stream is malformed, or cannot be written).
+	 */
+	bool receive();
+
+	/**
+	 * Prints the statistics of the last interval, and starts a new one.
+	 *
+	 * @param seconds The duration of the interval.
+	 * @returns The statistics of the interval.
+	 */
+	StreamStats report(double seconds);
+
+	/**
+	 * Returns the statistics since the connection, not counting the
+	 * current interval.
+	 */
+	StreamStats const &total() const {
+		return totals;
+	}
+
+	std::string const &name() const {
+		return peer;
+	}
+
+private:
+	bool parse(size_t &parsed);
+	void check_timing(uint8_t const *timing);
+	bool save(uint8_t const *data, size_t size);
+
+	const int socket;
+	const std::string peer;
+	BufferPool &pool;
+	uint8_t *const buffer;
+	size_t filled {0};
+	int file {-1};
+	bool records {false};
+
+	// The next block expected, and the samples dropped by the device so
+	// far, from the timing records.
+	uint64_t next_sequence {0};
+	uint64_t dropped {0};
+
+	StreamStats interval {}, totals {};
+};
+
+/**
+ * Prints statistics, as rates over an interval.
+ *
+ * @param name The name of the stream.
+ * @param stats The statistics.
+ * @param seconds The duration of the interval.
+ * @param records Whether the samples are records of the ils format.
+ */
+void print_stats(std::string const &name, StreamStats const &stats,
+		 double seconds, bool records = false);
+
+#endif  /* __ILSIMU_RASSERVER_CONNECTION_HPP */
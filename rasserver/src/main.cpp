@@ -0,0 +1,82 @@
+#include <iostream>
+#include <stdexcept>
+#include <string>
+
+#include <cstdlib>
+
+#include <unistd.h>
+
+#include "protocol.hpp"
+#include "server.hpp"
+
+static void usage(char const *name) {
+	std::cerr << "Usage: " << name << " [-p port]... [-o directory] "
+		  << "[-b buffer KiB] [-i interval ms]" << std::endl
+		  << std::endl
+		  << "  -p  A port to listen on (default 10001).  May be "
+		  << "repeated." << std::endl
+		  << "  -o  Writes each stream, as received, to a file of the "
+		  << "directory." << std::endl
+		  << "  -b  The receive buffer of each connection, which "
+		  << "must hold the largest" << std::endl
+		  << "      block (default 1024 KiB)." << std::endl
+		  << "  -i  The time between two reports (default 1000 ms)."
+		  << std::endl;
+}
+
+int main(int argc, char **argv) {
+	ServerOptions options {{}, 1024 * 1024, "",
+			       std::chrono::milliseconds {1000}};
+	int option;
+
+	try {
+		while ((option = getopt(argc, argv, "p:o:b:i:")) != -1) {
+			switch (option) {
+			case 'p':
+				options.ports.push_back(static_cast<uint16_t> (
+						std::stoul(optarg)));
+				break;
+			case 'o':
+				options.directory = optarg;
+				break;
+			case 'b':
+				options.buffer_size = std::stoul(optarg) * 1024;
+				break;
+			case 'i':
+				options.interval = std::chrono::milliseconds {
+					std::stoul(optarg)};
+				break;
+			default:
+				usage(argv[0]);
+				return EXIT_FAILURE;
+			}
+		}
+	} catch (std::logic_error &) {
+		// Thrown by std::stoul()
+		usage(argv[0]);
+		return EXIT_FAILURE;
+	}
+
+	// The header and the records of a block, at least, must fit.
+	if (optind != argc || options.interval.count() <= 0 ||
+	    options.buffer_size < protocol_header_size +
+	    protocol_records_size(protocol_known_flags)) {
+		usage(argv[0]);
+		return EXIT_FAILURE;
+	}
+
+	if (options.ports.empty()) {
+		options.ports.push_back(10001);
+	}
+
+	try {
+		Server server {std::move(options)};
+
+		server.run();
+	} catch (std::runtime_error &e) {
+		std::cerr << e.what() << std::endl;
+		return EXIT_FAILURE;
+	}
+
+	return EXIT_SUCCESS;
+}
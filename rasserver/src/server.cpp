@@ -0,0 +1,226 @@
+#include "server.hpp"
+
+#include <algorithm>
+#include <iostream>
+#include <stdexcept>
+
+#include <cerrno>
+#include <csignal>
+#include <cstring>
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/epoll.h>
+#include <sys/signalfd.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+/**
+ * Throws a std::runtime_error describing errno.
+ *
+ * @param what The operation which failed.
+ */
+[[noreturn]] static void throw_errno(std::string const &what) {
+	throw std::runtime_error {what + ": " + std::strerror(errno)};
+}
+
+Server::Server(ServerOptions options):
+	options {std::move(options)}, pool {this->options.buffer_size} {
+	sigset_t set;
+
+	if ((epoll = epoll_create1(EPOLL_CLOEXEC)) < 0) {
+		throw_errno("epoll_create1()");
+	}
+
+	// The signals are received through the loop, so that the
+	// connections are closed cleanly.
+	sigemptyset(&set);
+	sigaddset(&set, SIGINT);
+	sigaddset(&set, SIGTERM);
+
+	if (sigprocmask(SIG_BLOCK, &set, nullptr) < 0 ||
+	    (signals = signalfd(-1, &set, SFD_NONBLOCK | SFD_CLOEXEC)) < 0) {
+		close(epoll);
+		throw_errno("signalfd()");
+	}
+
+	try {
+		watch(signals);
+
+		for (uint16_t port: this->options.ports) {
+			listen_on(port);
+		}
+	} catch (std::runtime_error &) {
+		for (int fd: listeners) {
+			close(fd);
+		}
+
+		close(signals);
+		close(epoll);
+		throw;
+	}
+}
+
+Server::~Server() {
+	connections.clear();
+
+	for (int fd: listeners) {
+		close(fd);
+	}
+
+	close(signals);
+	close(epoll);
+}
+
+void Server::watch(int fd) {
+	epoll_event event {};
+
+	event.events = EPOLLIN;
+	event.data.fd = fd;
+
+	if (epoll_ctl(epoll, EPOLL_CTL_ADD, fd, &event) < 0) {
+		throw_errno("epoll_ctl()");
+	}
+}
+
+void Server::listen_on(uint16_t port) {
+	sockaddr_in address {};
+	int fd {socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC,
+		       0)};
+	int one {1};
+
+	if (fd < 0) {
+		throw_errno("socket()");
+	}
+
+	listeners.push_back(fd);
+
+	address.sin_family = AF_INET;
+	address.sin_addr.s_addr = htonl(INADDR_ANY);
+	address.sin_port = htons(port);
+
+	if (setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one)) < 0 ||
+	    bind(fd, reinterpret_cast<sockaddr *> (&address),
+		 sizeof(address)) < 0 ||
+	    listen(fd, SOMAXCONN) < 0) {
+		throw_errno("Could not listen on port " + std::to_string(port));
+	}
+
+	watch(fd);
+
+	std::cout << "Listening on port " << port << std::endl;
+}
+
+void Server::accept_connections(int listener) {
+	for (;;) {
+		sockaddr_in address {};
+		socklen_t length {sizeof(address)};
+		int fd {accept4(listener,
+				reinterpret_cast<sockaddr *> (&address),
+				&length, SOCK_NONBLOCK | SOCK_CLOEXEC)};
+
+		if (fd < 0) {
+			if (errno != EAGAIN && errno != EWOULDBLOCK &&
+			    errno != EINTR) {
+				std::cerr << "accept4(): " << std::strerror(errno)
+					  << std::endl;
+			}
+
+			return;
+		}
+
+		char host[INET_ADDRSTRLEN];
+		const std::string name {
+			std::string {inet_ntop(AF_INET, &address.sin_addr, host,
+					       sizeof(host))} +
+			":" + std::to_string(ntohs(address.sin_port))};
+		std::string file;
+
+		if (!options.directory.empty()) {
+			file = options.directory + "/" + std::to_string(accepted) +
+				"-" + name + ".ras";
+		}
+
+		accepted++;
+
+		try {
+			connections[fd] = std::make_unique<Connection> (
+				fd, name, pool, file);
+			watch(fd);
+		} catch (std::runtime_error &e) {
+			std::cerr << e.what() << std::endl;
+			connections.erase(fd);
+			continue;
+		}
+
+		std::cout << "[" << name << "] Connected" << std::endl;
+	}
+}
+
+void Server::close_connection(int fd) {
+	auto connection = connections.find(fd);
+	const double seconds {std::chrono::duration<double> (
+			std::chrono::steady_clock::now() - last_report).count()};
+
+	// The current interval is reported, and counted in the totals.
+	connection->second->report(seconds);
+	std::cout << "[" << connection->second->name() << "] Closed, "
+		  << connection->second->total().blocks << " blocks, "
+		  << connection->second->total().bytes << " bytes" << std::endl;
+
+	epoll_ctl(epoll, EPOLL_CTL_DEL, fd, nullptr);
+	connections.erase(connection);
+}
+
+void Server::report() {
+	const auto now = std::chrono::steady_clock::now();
+	const double seconds {std::chrono::duration<double> (
+			now - last_report).count()};
+	StreamStats total {};
+
+	for (auto &connection: connections) {
+		total += connection.second->report(seconds);
+	}
+
+	if (connections.size() > 1) {
+		print_stats("total", total, seconds);
+	}
+
+	last_report = now;
+}
+
+void Server::run() {
+	constexpr int max_events {64};
+	epoll_event events[max_events];
+
+	last_report = std::chrono::steady_clock::now();
+
+	for (;;) {
+		const auto next = last_report + options.interval;
+		const int timeout {static_cast<int> (std::max<int64_t> (
+			0, std::chrono::duration_cast<std::chrono::milliseconds> (
+				next - std::chrono::steady_clock::now()).count()))};
+		const int n {epoll_wait(epoll, events, max_events, timeout)};
+
+		if (n < 0 && errno != EINTR) {
+			throw_errno("epoll_wait()");
+		}
+
+		for (int i = 0; i < n; i++) {
+			const int fd {events[i].data.fd};
+
+			if (fd == signals) {
+				return;
+			} else if (std::find(listeners.begin(), listeners.end(),
+					     fd) != listeners.end()) {
+				accept_connections(fd);
+			} else if (!connections.at(fd)->receive()) {
+				close_connection(fd);
+			}
+		}
+
+		if (std::chrono::steady_clock::now() >= next) {
+			report();
+		}
+	}
+}
@@ -0,0 +1,91 @@
+#ifndef __ILSIMU_RASSERVER_SERVER_HPP
+# define __ILSIMU_RASSERVER_SERVER_HPP
+
+# include <chrono>
+# include <map>
+# include <memory>
+# include <string>
+# include <vector>
+
+# include "buffer_pool.hpp"
+# include "connection.hpp"
+
+/**
+ * The parameters of a server.
+ */
+struct ServerOptions {
+	/**
+	 * The ports to listen on, on every address.
+	 */
+	std::vector<uint16_t> ports;
+
+	/**
+	 * The size of the receive buffer of each connection, in bytes.  It
+	 * must hold the largest block.
+	 */
+	size_t buffer_size;
+
+	/**
+	 * The directory where the streams are written, or an empty string.
+	 */
+	std::string directory;
+
+	/**
+	 * The time between two reports.
+	 */
+	std::chrono::milliseconds interval;
+};
+
+/**
+ * A server receiving the streams of several rasseiver connections, on a
+ * single thread.
+ *
+ * The sockets are non-blocking and multiplexed with epoll, as are SIGINT and
+ * SIGTERM, through a signalfd.  The throughput of each connection is
+ * reported periodically.
+ */
+class Server {
+public:
+	Server() = delete;
+
+	/**
+	 * Opens the listening sockets.  If one cannot be opened, a
+	 * std::runtime_error is thrown.
+	 *
+	 * @param options The parameters of the server.
+	 */
+	Server(ServerOptions options);
+
+	/**
+	 * Closes the connections and the listening sockets.
+	 */
+	~Server();
+
+	Server(Server const &) = delete;
+	Server &operator=(Server const &) = delete;
+
+	/**
+	 * Receives the streams until SIGINT or SIGTERM is received.
+	 */
+	void run();
+
+private:
+	void watch(int fd);
+	void listen_on(uint16_t port);
+	void accept_connections(int listener);
+	void close_connection(int fd);
+	void report();
+
+	const ServerOptions options;
+	BufferPool pool;
+
+	int epoll {-1};
+	int signals {-1};
+	std::vector<int> listeners;
+	std::map<int, std::unique_ptr<Connection>> connections;
+	uint64_t accepted {0};
+
+	std::chrono::steady_clock::time_point last_report;
+};
+
+#endif  /* __ILSIMU_RASSERVER_SERVER_HPP */
@@ -0,0 +1,67 @@
+#!/bin/bash
+
+# Checks that the real-time paths of rasseiver (the device callback and the
+# sending of blocks) never allocate memory.
+
+NUM_CPU=$(nproc)
+
+if [ -z "$DECIMATION" ]
+then
+    DECIMATION=60
+fi
+
+if [ -z "$FILTER" ]
+then
+    PROJECT_DIR=$(realpath "$(dirname "$0")"/..)
+    FILTER="$PROJECT_DIR"/rasseiver/examples/LPDFilter.fcf
+fi
+
+if [ -z "$PORT" ]
+then
+   PORT=10001
+fi
+
+if [ -z "$COUNT" ]
+then
+    COUNT=50
+fi
+
+echo "Build rasseiver with the allocation guard"
+
+cmake "$@" -DALLOC_GUARD=1
+make -j$NUM_CPU || exit 1
+
+cat >alloc-check-config <<EOF2
+device=dummy
+count=$COUNT
+port=$PORT
+filter=$FILTER
+decimation=$DECIMATION
+EOF2
+
+for options in "" "compression=1" "metering=1" "precision=float" \
+               "filter_threads=2"
+do
+    echo
+    echo "Run with: ${options:-default options}"
+
+    cp alloc-check-config alloc-check-run
+    [ -n "$options" ] && echo "$options" >>alloc-check-run
+
+    socat /dev/null,ignoreeof tcp-listen:$PORT &
+    sleep 0.5
+    rasseiver/rasseiver alloc-check-run
+    status=$?
+    wait
+
+    if [ $status -ne 0 ]
+    then
+        echo "Failed."
+        rm alloc-check-config alloc-check-run
+        exit 1
+    fi
+done
+
+rm alloc-check-config alloc-check-run
+
+echo "Done."
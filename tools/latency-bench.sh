@@ -0,0 +1,66 @@
+#!/bin/bash
+
+# Measures the latency of the output of rasseiver, and the rate of its sends,
+# for several sizes of output blocks.  The latency of a block is the time
+# between the capture of its oldest input and the end of its send, as seen by
+# rasseiver, or its reception, from the timing records received by rasserver.
+# It includes the wait for the rest of the buffer of the device, so large
+# buffers are slower than small blocks.
+#
+# Run it from a build directory, after building rasseiver and rasserver.  The
+# sizes tested can be given as arguments, in milliseconds of output (0 for one
+# block for each buffer of the device).
+
+if [ -z "$DECIMATION" ]
+then
+    DECIMATION=60
+fi
+
+if [ -z "$FILTER" ]
+then
+    PROJECT_DIR=$(realpath "$(dirname "$0")"/..)
+    FILTER="$PROJECT_DIR"/rasseiver/examples/LPDFilter.fcf
+fi
+
+if [ -z "$PORT" ]
+then
+   PORT=10001
+fi
+
+if [ -z "$COUNT" ]
+then
+    COUNT=200
+fi
+
+if [ "$#" -eq 0 ]
+then
+    set -- 0 1 2 5 10 50
+fi
+
+cat >latency-bench-config <<EOF2
+device=dummy
+count=$COUNT
+port=$PORT
+filter=$FILTER
+decimation=$DECIMATION
+timing=1
+EOF2
+
+for ms in "$@"
+do
+    cp latency-bench-config latency-bench-run
+    echo "output_block_ms=$ms" >>latency-bench-run
+
+    # A single report, when the connection is closed.
+    rasserver/rasserver -p "$PORT" -i 3600000 >latency-bench-server &
+    server=$!
+    sleep 0.5
+    sent=$(rasseiver/rasseiver latency-bench-run | grep "Output latency")
+    sleep 0.5
+    kill "$server"
+    wait "$server"
+    echo "output_block_ms=$ms: $sent," \
+         "received: $(grep -o "latency mean/max [^,]*" latency-bench-server)"
+done
+
+rm latency-bench-config latency-bench-run latency-bench-server
@@ -0,0 +1,39 @@
+#!/bin/bash
+
+# Compares the accuracy and the speed of the filtering engines, in double,
+# single and fixed-point precision, on the same quantised noisy tone.  The
+# SNR of each engine is measured against the double precision filter of the
+# samples before quantisation, so its loss is what it adds to the
+# quantisation noise of the ADC.
+#
+# Run it from a build directory, after building rasseiver.  The max value of
+# the samples is 2048 (12 bits) unless MAX_VALUE is set.  The engines run on
+# each amount of threads of THREADS in turn (eg. THREADS="1 2 4 8"), to
+# measure how the filtering scales.
+
+if [ -z "$DECIMATION" ]
+then
+    DECIMATION=60
+fi
+
+if [ -z "$FILTER" ]
+then
+    PROJECT_DIR=$(realpath "$(dirname "$0")"/..)
+    FILTER="$PROJECT_DIR"/rasseiver/examples/LPDFilter.fcf
+fi
+
+if [ -z "$MAX_VALUE" ]
+then
+    MAX_VALUE=2048
+fi
+
+if [ -z "$THREADS" ]
+then
+    THREADS=1
+fi
+
+for threads in $THREADS
+do
+    rasseiver/filter-bench -d "$DECIMATION" -m "$MAX_VALUE" -t "$threads" \
+        "$FILTER"
+done